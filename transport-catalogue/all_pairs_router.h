@@ -0,0 +1,165 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // All-pairs router with the same relaxation order as graph::Router, so the table and the
+    // routes it returns are identical. For every intermediate vertex, rows of the table are
+    // relaxed in parallel: each thread owns a contiguous block of source rows, and the row of the
+    // intermediate vertex itself never changes during its own step.
+    // The table is one flat V * V array of 16-byte entries.
+    template <typename Weight>
+    class AllPairsRouter {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        struct RouteInternalData {
+            Weight weight;
+            EdgeId prev_edge;
+        };
+
+        AllPairsRouter(const Graph& graph, size_t thread_count);
+        // Adopts a table previously taken from GetRoutesInternalData() for the same graph
+        AllPairsRouter(const Graph& graph, std::vector<RouteInternalData> routes_internal_data);
+
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+        // Route weight only, straight from the table
+        std::optional<Weight> GetWeight(VertexId from, VertexId to) const {
+            const auto& route_internal_data = GetRoute(from, to);
+            if (route_internal_data.prev_edge == NO_ROUTE) {
+                return std::nullopt;
+            }
+            return route_internal_data.weight;
+        }
+
+        const std::vector<RouteInternalData>& GetRoutesInternalData() const {
+            return routes_internal_data_;
+        }
+
+    private:
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+        static constexpr EdgeId NO_ROUTE = static_cast<EdgeId>(-2);
+
+        RouteInternalData& GetRoute(VertexId from, VertexId to) {
+            return routes_internal_data_[from * vertex_count_ + to];
+        }
+
+        const RouteInternalData& GetRoute(VertexId from, VertexId to) const {
+            return routes_internal_data_[from * vertex_count_ + to];
+        }
+
+        void InitializeRoutesInternalData();
+        void RelaxRowsThroughVertex(VertexId vertex_through, VertexId row_begin, VertexId row_end);
+
+        const Graph& graph_;
+        size_t vertex_count_;
+        std::vector<RouteInternalData> routes_internal_data_;
+    };
+
+    template <typename Weight>
+    AllPairsRouter<Weight>::AllPairsRouter(const Graph& graph, size_t thread_count)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , routes_internal_data_(vertex_count_ * vertex_count_, { ZERO_WEIGHT, NO_ROUTE })
+    {
+        InitializeRoutesInternalData();
+
+        const size_t workers = std::max<size_t>(1, std::min(thread_count, vertex_count_));
+        parallel::Barrier barrier(workers);
+
+        parallel::ForEachThread(workers, [&](size_t thread_index) {
+            const VertexId row_begin = vertex_count_ * thread_index / workers;
+            const VertexId row_end = vertex_count_ * (thread_index + 1) / workers;
+            for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+                RelaxRowsThroughVertex(vertex_through, row_begin, row_end);
+                barrier.Wait();
+            }
+        });
+    }
+
+    template <typename Weight>
+    AllPairsRouter<Weight>::AllPairsRouter(const Graph& graph, std::vector<RouteInternalData> routes_internal_data)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , routes_internal_data_(std::move(routes_internal_data))
+    {
+        if (routes_internal_data_.size() != vertex_count_ * vertex_count_) {
+            throw std::invalid_argument("Routes table does not match the graph");
+        }
+    }
+
+    template <typename Weight>
+    void AllPairsRouter<Weight>::InitializeRoutesInternalData() {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            GetRoute(vertex, vertex) = { ZERO_WEIGHT, NO_EDGE };
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                if (edge.weight < ZERO_WEIGHT) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                auto& route_internal_data = GetRoute(vertex, edge.to);
+                if (route_internal_data.prev_edge == NO_ROUTE || route_internal_data.weight > edge.weight) {
+                    route_internal_data = { edge.weight, edge_id };
+                }
+            }
+        }
+    }
+
+    template <typename Weight>
+    void AllPairsRouter<Weight>::RelaxRowsThroughVertex(VertexId vertex_through, VertexId row_begin, VertexId row_end) {
+        const RouteInternalData* row_through = &routes_internal_data_[vertex_through * vertex_count_];
+
+        for (VertexId vertex_from = row_begin; vertex_from < row_end; ++vertex_from) {
+            const RouteInternalData route_from = GetRoute(vertex_from, vertex_through);
+            if (route_from.prev_edge == NO_ROUTE) {
+                continue;
+            }
+            RouteInternalData* row_from = &routes_internal_data_[vertex_from * vertex_count_];
+
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                const RouteInternalData& route_to = row_through[vertex_to];
+                if (route_to.prev_edge == NO_ROUTE) {
+                    continue;
+                }
+                auto& route_relaxing = row_from[vertex_to];
+                const Weight candidate_weight = route_from.weight + route_to.weight;
+                if (route_relaxing.prev_edge == NO_ROUTE || candidate_weight < route_relaxing.weight) {
+                    route_relaxing = { candidate_weight, route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge };
+                }
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename AllPairsRouter<Weight>::RouteInfo> AllPairsRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+        const auto& route_internal_data = GetRoute(from, to);
+        if (route_internal_data.prev_edge == NO_ROUTE) {
+            return std::nullopt;
+        }
+
+        const Weight weight = route_internal_data.weight;
+        std::vector<EdgeId> edges;
+        for (EdgeId edge_id = route_internal_data.prev_edge; edge_id != NO_EDGE; edge_id = GetRoute(from, graph_.GetEdge(edge_id).from).prev_edge) {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ weight, std::move(edges) };
+    }
+
+}
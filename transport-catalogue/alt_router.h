@@ -0,0 +1,317 @@
+#pragma once
+
+#include "graph.h"
+#include "csr_graph.h"
+#include "dijkstra_router.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // A* with ALT (landmarks and the triangle inequality).
+    // At build time landmarks are chosen by farthest-point selection, and the distances from
+    // every landmark and to every landmark are stored: 2 * landmark_count weights per vertex.
+    // The heuristic of v towards target t is the largest of
+    //     d(L, t) - d(L, v),  d(v, L) - d(t, L)  over all landmarks L
+    // and of the optional caller-supplied lower_bound(v, t), which must itself be a consistent
+    // lower bound of the distance (e.g. straight-line distance over the top speed).
+    // Graph is DirectedWeightedGraph or its frozen CsrGraph copy.
+    template <typename Weight, typename Graph = DirectedWeightedGraph<Weight>>
+    class AltRouter {
+    public:
+        using LowerBound = std::function<Weight(VertexId, VertexId)>;
+
+        AltRouter(const Graph& graph, size_t landmark_count, size_t thread_count, LowerBound lower_bound = {});
+
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+        size_t GetLandmarkCount() const {
+            return landmarks_.size();
+        }
+
+    private:
+        struct VertexState {
+            Weight weight;
+            Weight heuristic;
+            std::optional<EdgeId> prev_edge;
+            uint32_t stamp = 0;
+            bool settled = false;
+        };
+
+        struct SearchSpace {
+            std::vector<VertexState> states;
+            uint32_t stamp = 0;
+
+            void Reset(size_t vertex_count) {
+                if (states.size() < vertex_count) {
+                    states.resize(vertex_count);
+                }
+                if (++stamp == 0) {
+                    for (auto& state : states) {
+                        state.stamp = 0;
+                    }
+                    stamp = 1;
+                }
+            }
+        };
+
+        // Incoming edges of every vertex, for the distances to the landmarks
+        struct BackwardGraph {
+            std::vector<size_t> offsets;
+            std::vector<VertexId> sources;
+            std::vector<Weight> weights;
+        };
+
+        using QueueElem = std::pair<Weight, VertexId>;
+        using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<QueueElem>>;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::max();
+
+        BackwardGraph BuildBackwardGraph() const;
+        void SelectLandmarks(size_t landmark_count);
+        // Full single-source distances, forward over graph_ or backward over backward_graph
+        std::vector<Weight> ComputeDistances(VertexId source, const BackwardGraph* backward_graph) const;
+        Weight ComputeHeuristic(VertexId vertex, VertexId to, const std::vector<Weight>& target_from, const std::vector<Weight>& target_to) const;
+
+        const Graph& graph_;
+        LowerBound lower_bound_;
+        std::vector<VertexId> landmarks_;
+        // Vertex-major: entry vertex * landmark count + landmark index
+        std::vector<Weight> distance_from_landmark_;
+        std::vector<Weight> distance_to_landmark_;
+    };
+
+    template <typename Weight, typename Graph>
+    AltRouter<Weight, Graph>::AltRouter(const Graph& graph, size_t landmark_count, size_t thread_count, LowerBound lower_bound)
+        : graph_(graph)
+        , lower_bound_(std::move(lower_bound))
+    {
+        for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+            if (graph_.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+
+        SelectLandmarks(std::min(landmark_count, graph_.GetVertexCount()));
+
+        const size_t vertex_count = graph_.GetVertexCount();
+        const size_t count = landmarks_.size();
+        distance_from_landmark_.resize(vertex_count * count);
+        distance_to_landmark_.resize(vertex_count * count);
+
+        const BackwardGraph backward_graph = BuildBackwardGraph();
+        parallel::ForEachIndex(2 * count, thread_count, [&](size_t job) {
+            const size_t index = job % count;
+            const bool backward = job >= count;
+            const auto distances = ComputeDistances(landmarks_[index], backward ? &backward_graph : nullptr);
+            auto& table = backward ? distance_to_landmark_ : distance_from_landmark_;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                table[vertex * count + index] = distances[vertex];
+            }
+        });
+    }
+
+    template <typename Weight, typename Graph>
+    typename AltRouter<Weight, Graph>::BackwardGraph AltRouter<Weight, Graph>::BuildBackwardGraph() const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        BackwardGraph backward_graph{ std::vector<size_t>(vertex_count + 1, 0), std::vector<VertexId>(graph_.GetEdgeCount()), std::vector<Weight>(graph_.GetEdgeCount()) };
+
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            ForEachOutgoingEdge(graph_, vertex, [&](EdgeId, VertexId to, Weight) {
+                ++backward_graph.offsets[to + 1];
+            });
+        }
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            backward_graph.offsets[vertex + 1] += backward_graph.offsets[vertex];
+        }
+
+        std::vector<size_t> positions(backward_graph.offsets.begin(), backward_graph.offsets.end() - 1);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            ForEachOutgoingEdge(graph_, vertex, [&](EdgeId, VertexId to, Weight weight) {
+                const size_t position = positions[to]++;
+                backward_graph.sources[position] = vertex;
+                backward_graph.weights[position] = weight;
+            });
+        }
+        return backward_graph;
+    }
+
+    // Farthest-point selection: every next landmark is the reachable vertex farthest from the
+    // ones chosen so far. Only when every remaining vertex is unreachable from them does the
+    // next landmark go to an unreachable one, so a disconnected network still gets covered.
+    template <typename Weight, typename Graph>
+    void AltRouter<Weight, Graph>::SelectLandmarks(size_t landmark_count) {
+        const size_t vertex_count = graph_.GetVertexCount();
+        std::vector<Weight> nearest_landmark(vertex_count, UNREACHABLE);
+        std::vector<bool> is_landmark(vertex_count, false);
+
+        VertexId candidate = 0;
+        while (landmarks_.size() < landmark_count) {
+            landmarks_.push_back(candidate);
+            is_landmark[candidate] = true;
+
+            const auto distances = ComputeDistances(candidate, nullptr);
+            std::optional<VertexId> farthest;
+            std::optional<VertexId> unreached;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                nearest_landmark[vertex] = std::min(nearest_landmark[vertex], distances[vertex]);
+                if (is_landmark[vertex]) {
+                    continue;
+                }
+                if (nearest_landmark[vertex] == UNREACHABLE) {
+                    unreached = unreached.value_or(vertex);
+                }
+                else if (!farthest || nearest_landmark[vertex] > nearest_landmark[*farthest]) {
+                    farthest = vertex;
+                }
+            }
+            if (!farthest && !unreached) {
+                break;
+            }
+            candidate = farthest ? *farthest : *unreached;
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    std::vector<Weight> AltRouter<Weight, Graph>::ComputeDistances(VertexId source, const BackwardGraph* backward_graph) const {
+        std::vector<Weight> distances(graph_.GetVertexCount(), UNREACHABLE);
+        Queue queue;
+        distances[source] = ZERO_WEIGHT;
+        queue.push({ ZERO_WEIGHT, source });
+
+        while (!queue.empty()) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            if (distances[vertex] < weight) {
+                continue;
+            }
+
+            auto relax = [&, weight = weight](VertexId next_vertex, Weight edge_weight) {
+                const Weight candidate = weight + edge_weight;
+                if (candidate < distances[next_vertex]) {
+                    distances[next_vertex] = candidate;
+                    queue.push({ candidate, next_vertex });
+                }
+            };
+
+            if (backward_graph != nullptr) {
+                for (size_t position = backward_graph->offsets[vertex]; position < backward_graph->offsets[vertex + 1]; ++position) {
+                    relax(backward_graph->sources[position], backward_graph->weights[position]);
+                }
+            }
+            else {
+                ForEachOutgoingEdge(graph_, vertex, [&](EdgeId, VertexId next_vertex, Weight edge_weight) {
+                    relax(next_vertex, edge_weight);
+                });
+            }
+        }
+        return distances;
+    }
+
+    template <typename Weight, typename Graph>
+    Weight AltRouter<Weight, Graph>::ComputeHeuristic(VertexId vertex, VertexId to, const std::vector<Weight>& target_from, const std::vector<Weight>& target_to) const {
+        Weight heuristic = lower_bound_ ? lower_bound_(vertex, to) : ZERO_WEIGHT;
+
+        const size_t count = landmarks_.size();
+        const Weight* vertex_from = &distance_from_landmark_[vertex * count];
+        const Weight* vertex_to = &distance_to_landmark_[vertex * count];
+        for (size_t index = 0; index < count; ++index) {
+            if (target_from[index] != UNREACHABLE && vertex_from[index] != UNREACHABLE) {
+                heuristic = std::max(heuristic, target_from[index] - vertex_from[index]);
+            }
+            if (vertex_to[index] != UNREACHABLE && target_to[index] != UNREACHABLE) {
+                heuristic = std::max(heuristic, vertex_to[index] - target_to[index]);
+            }
+        }
+        return heuristic;
+    }
+
+    template <typename Weight, typename Graph>
+    std::optional<typename AltRouter<Weight, Graph>::RouteInfo> AltRouter<Weight, Graph>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        space.Reset(graph_.GetVertexCount());
+        auto& states = space.states;
+        const uint32_t stamp = space.stamp;
+
+        const size_t count = landmarks_.size();
+        const std::vector<Weight> target_from(distance_from_landmark_.begin() + to * count, distance_from_landmark_.begin() + (to + 1) * count);
+        const std::vector<Weight> target_to(distance_to_landmark_.begin() + to * count, distance_to_landmark_.begin() + (to + 1) * count);
+
+        // The queue is keyed on weight + heuristic; both heuristics are consistent, so a vertex
+        // is final when it is settled, as in Dijkstra
+        Queue queue;
+        const Weight source_heuristic = ComputeHeuristic(from, to, target_from, target_to);
+        states.at(from) = { ZERO_WEIGHT, source_heuristic, std::nullopt, stamp, false };
+        queue.push({ source_heuristic, from });
+
+        SearchStats search_stats;
+        ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+        while (!queue.empty()) {
+            const auto [key, vertex] = queue.top();
+            queue.pop();
+            ROUTER_INSTRUMENT(++search_stats.heap_pops;)
+
+            auto& state = states[vertex];
+            if (state.settled || state.weight + state.heuristic < key) {
+                continue;
+            }
+            state.settled = true;
+            ++search_stats.settled_vertices;
+            if (vertex == to) {
+                break;
+            }
+
+            const Weight weight = state.weight;
+            ForEachOutgoingEdge(graph_, vertex, [&](EdgeId edge_id, VertexId next_vertex, Weight edge_weight) {
+                ROUTER_INSTRUMENT(++search_stats.relaxed_edges;)
+                auto& next = states[next_vertex];
+                const Weight candidate = weight + edge_weight;
+                if (next.stamp != stamp) {
+                    next = { candidate, ComputeHeuristic(next_vertex, to, target_from, target_to), edge_id, stamp, false };
+                    queue.push({ candidate + next.heuristic, next_vertex });
+                    ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+                }
+                else if (!next.settled && candidate < next.weight) {
+                    next.weight = candidate;
+                    next.prev_edge = edge_id;
+                    queue.push({ candidate + next.heuristic, next_vertex });
+                    ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+                }
+            });
+        }
+
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+
+        const auto& target = states[to];
+        if (target.stamp != stamp || !target.settled) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (std::optional<EdgeId> edge_id = target.prev_edge; edge_id; edge_id = states[graph_.GetEdge(*edge_id).from].prev_edge) {
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ target.weight, std::move(edges) };
+    }
+
+}
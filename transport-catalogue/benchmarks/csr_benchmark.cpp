@@ -0,0 +1,170 @@
+// Dijkstra query time and cache misses on the incidence-list graph against its frozen CSR copy.
+// Edges are added in random order, as a generated transport graph interleaves them, so the
+// incidence lists of neighbouring vertices end up scattered over the edge array.
+// Cache misses are read from the hardware counters of perf_event_open (Linux, user space only);
+// where the kernel or the machine does not provide them they are reported as n/a.
+//
+// Build from transport-catalogue/:
+//   g++ -std=c++20 -O2 -I. benchmarks/csr_benchmark.cpp -o csr_benchmark
+// Run:
+//   ./csr_benchmark [vertex_count] [edges_per_vertex] [query_count]
+// Where the counters are n/a, whole-run totals of both variants together are still available from
+//   perf stat -e cache-misses ./csr_benchmark
+
+#include "csr_graph.h"
+#include "dijkstra_router.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    const uint32_t SEED = 20240601;
+    const int ROUND_COUNT = 3;
+
+    // Hardware cache-miss counter of this thread; IsValid() is false where it cannot be opened
+    class CacheMissCounter {
+    public:
+        CacheMissCounter() {
+#ifdef __linux__
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        CacheMissCounter(const CacheMissCounter&) = delete;
+        CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+        ~CacheMissCounter() {
+#ifdef __linux__
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+
+        bool IsValid() const {
+            return fd_ >= 0;
+        }
+
+        void Start() {
+#ifdef __linux__
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        // Misses since Start()
+        uint64_t Stop() {
+            uint64_t count = 0;
+#ifdef __linux__
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                    count = 0;
+                }
+            }
+#endif
+            return count;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    struct RunResult {
+        double ms_per_query = 0;
+        uint64_t cache_misses = 0;
+    };
+
+    template <typename Graph>
+    RunResult RunQueries(const Graph& graph, const std::vector<std::pair<graph::VertexId, graph::VertexId>>& queries, std::vector<double>& weights, CacheMissCounter& counter) {
+        graph::DijkstraRouter<double, Graph> router(graph);
+        weights.clear();
+        counter.Start();
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& [from, to] : queries) {
+            const auto route = router.BuildRoute(from, to);
+            weights.push_back(route.has_value() ? route->weight : -1);
+        }
+        const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const uint64_t misses = counter.Stop();
+        const size_t count = std::max<size_t>(queries.size(), 1);
+        return { time / count, misses / count };
+    }
+
+    std::string FormatMisses(const CacheMissCounter& counter, uint64_t misses) {
+        return counter.IsValid() ? std::to_string(misses) : "n/a";
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const size_t vertex_count = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const size_t edges_per_vertex = argc > 2 ? std::stoul(argv[2]) : 6;
+    const size_t query_count = argc > 3 ? std::stoul(argv[3]) : 20;
+    if (vertex_count == 0) {
+        std::cerr << "Usage: " << argv[0] << " [vertex_count] [edges_per_vertex] [query_count]" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 random(SEED);
+    std::uniform_int_distribution<graph::VertexId> any_vertex(0, vertex_count - 1);
+    std::uniform_real_distribution<double> any_weight(1, 100);
+
+    std::vector<graph::Edge<double>> edges;
+    edges.reserve(vertex_count * edges_per_vertex);
+    for (graph::VertexId from = 0; from < vertex_count; ++from) {
+        for (size_t i = 0; i < edges_per_vertex; ++i) {
+            edges.push_back({ from, any_vertex(random), any_weight(random) });
+        }
+    }
+    std::shuffle(edges.begin(), edges.end(), random);
+
+    graph::DirectedWeightedGraph<double> list_graph(vertex_count);
+    for (const auto& edge : edges) {
+        list_graph.AddEdge(edge);
+    }
+    const graph::CsrGraph<double> csr_graph(list_graph);
+
+    std::vector<std::pair<graph::VertexId, graph::VertexId>> queries;
+    for (size_t i = 0; i < query_count; ++i) {
+        queries.push_back({ any_vertex(random), any_vertex(random) });
+    }
+
+    std::cout << vertex_count << " vertices, " << edges.size() << " edges, " << query_count << " queries\n" << std::fixed << std::setprecision(1);
+    CacheMissCounter counter;
+    std::vector<double> list_weights;
+    std::vector<double> csr_weights;
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        const RunResult list = RunQueries(list_graph, queries, list_weights, counter);
+        const RunResult csr = RunQueries(csr_graph, queries, csr_weights, counter);
+        std::cout << "incidence lists " << list.ms_per_query << " ms/query, " << FormatMisses(counter, list.cache_misses) << " cache misses/query; "
+            << "csr " << csr.ms_per_query << " ms/query, " << FormatMisses(counter, csr.cache_misses) << " cache misses/query\n";
+        if (list_weights != csr_weights) {
+            std::cerr << "Route weights differ between the graphs" << std::endl;
+            return 1;
+        }
+    }
+}
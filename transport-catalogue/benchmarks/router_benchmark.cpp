@@ -0,0 +1,226 @@
+// Preprocessing and route query time of one router type on a generated catalogue.
+// One router type per run, so the peak RSS printed at the end belongs to it alone.
+//
+// Build from transport-catalogue/:
+//   g++ -std=c++20 -O2 -I. benchmarks/router_benchmark.cpp transport_catalogue.cpp transport_router.cpp
+//       geo.cpp raptor.cpp connection_scan.cpp serialization.cpp -pthread -o router_benchmark
+// Run:
+//   ./router_benchmark <router_type> [stop_count] [bus_count] [query_count]
+//   router_type: all_pairs, dijkstra, contraction_hierarchies, alt, partitioned, raptor
+//
+// The catalogue and the queries depend only on the counts, so the checksum line must be the
+// same for every router type. Then the router is customized for new costs and checked against
+// one built for them from scratch; the run fails if any route differs.
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+    const uint32_t SEED = 20240601;
+    // A bus moves on to whichever of this many stops nearest to its last one is nearest to its
+    // terminal, and ends where none of them is nearer than the last stop
+    const size_t NEIGHBOUR_COUNT = 6;
+    const size_t MAX_BUS_STOP_COUNT = 40;
+
+    using Queries = std::vector<std::pair<std::string_view, std::string_view>>;
+
+    void FillCatalogue(catalogue::TransportCatalogue& catalogue, size_t stop_count, size_t bus_count) {
+        std::mt19937 random(SEED);
+        std::uniform_real_distribution<double> lat(55.55, 55.95);
+        std::uniform_real_distribution<double> lng(37.35, 37.85);
+
+        std::vector<geo::Coordinates> coords(stop_count);
+        for (size_t i = 0; i < stop_count; ++i) {
+            coords[i] = { lat(random), lng(random) };
+            catalogue.AddStop("Stop " + std::to_string(i), coords[i]);
+        }
+
+        std::vector<std::vector<size_t>> neighbours(stop_count);
+        for (size_t i = 0; i < stop_count; ++i) {
+            std::vector<std::pair<double, size_t>> by_distance;
+            for (size_t j = 0; j < stop_count; ++j) {
+                if (j != i) {
+                    by_distance.push_back({ geo::ComputeDistance(coords[i], coords[j]), j });
+                }
+            }
+            const size_t count = std::min(NEIGHBOUR_COUNT, by_distance.size());
+            std::partial_sort(by_distance.begin(), by_distance.begin() + count, by_distance.end());
+            for (size_t k = 0; k < count; ++k) {
+                neighbours[i].push_back(by_distance[k].second);
+            }
+        }
+
+        std::uniform_int_distribution<size_t> any_stop(0, stop_count - 1);
+        std::vector<std::vector<size_t>> routes;
+        for (size_t bus = 0; bus < bus_count; ++bus) {
+            const size_t terminal = any_stop(random);
+            std::vector<size_t> route = { any_stop(random) };
+            while (route.back() != terminal && route.size() < MAX_BUS_STOP_COUNT) {
+                size_t next = route.back();
+                for (const size_t neighbour : neighbours[route.back()]) {
+                    if (geo::ComputeDistance(coords[neighbour], coords[terminal]) < geo::ComputeDistance(coords[next], coords[terminal])) {
+                        next = neighbour;
+                    }
+                }
+                if (next == route.back()) {
+                    break;
+                }
+                route.push_back(next);
+            }
+            routes.push_back(std::move(route));
+        }
+
+        // Road distances are 1.3 times the straight line, a little longer back
+        for (const auto& route : routes) {
+            for (size_t i = 1; i < route.size(); ++i) {
+                const int distance = static_cast<int>(geo::ComputeDistance(coords[route[i - 1]], coords[route[i]]) * 1.3) + 1;
+                catalogue.AddDistance("Stop " + std::to_string(route[i - 1]), "Stop " + std::to_string(route[i]), distance);
+                catalogue.AddDistance("Stop " + std::to_string(route[i]), "Stop " + std::to_string(route[i - 1]), distance + 50);
+            }
+        }
+        for (size_t bus = 0; bus < routes.size(); ++bus) {
+            std::vector<const Stop*> stops;
+            for (const size_t stop : routes[bus]) {
+                stops.push_back(catalogue.FindStopByName("Stop " + std::to_string(stop)));
+            }
+            catalogue.AddBus("Bus " + std::to_string(bus), stops, false);
+        }
+        catalogue.Finalize(1);
+    }
+
+    // Peak resident set size in kB, 0 where /proc is not available
+    size_t GetPeakRss() {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("VmHWM:", 0) == 0) {
+                return std::strtoul(line.c_str() + 6, nullptr, 10);
+            }
+        }
+        return 0;
+    }
+
+    double GetSecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Travel time of every query, -1 where there is no route
+    std::vector<double> RunQueries(router::TransportRouter& router, const Queries& queries) {
+        std::vector<double> times;
+        times.reserve(queries.size());
+        for (const auto& [from, to] : queries) {
+            const auto route = router.ComputeRoute(from, to);
+            double time = route.has_value() ? 0 : -1;
+            if (route.has_value()) {
+                for (const auto& elem : route.value()) {
+                    time += elem.time;
+                }
+            }
+            times.push_back(time);
+        }
+        return times;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const std::map<std::string, router::RouterType> router_types = {
+        { "all_pairs", router::RouterType::ALL_PAIRS },
+        { "dijkstra", router::RouterType::DIJKSTRA },
+        { "contraction_hierarchies", router::RouterType::CONTRACTION_HIERARCHIES },
+        { "alt", router::RouterType::ALT },
+        { "partitioned", router::RouterType::PARTITIONED },
+        { "raptor", router::RouterType::RAPTOR },
+    };
+    if (argc < 2 || !router_types.count(argv[1])) {
+        std::cerr << "Usage: " << argv[0] << " <router_type> [stop_count] [bus_count] [query_count]" << std::endl;
+        return 1;
+    }
+    const size_t stop_count = argc > 2 ? std::stoul(argv[2]) : 1500;
+    const size_t bus_count = argc > 3 ? std::stoul(argv[3]) : 400;
+    const size_t query_count = argc > 4 ? std::stoul(argv[4]) : 3000;
+
+    catalogue::TransportCatalogue catalogue;
+    FillCatalogue(catalogue, stop_count, bus_count);
+
+    router::RoutingSettings settings;
+    settings.bus_wait_time = 6;
+    settings.bus_velocity = 40;
+    settings.router_type = router_types.at(argv[1]);
+    settings.thread_count = 1;
+
+    auto start = std::chrono::steady_clock::now();
+    router::TransportRouter router(catalogue, settings);
+    const double build_time = GetSecondsSince(start);
+
+    // Stops no bus calls at would only add trivial "not found" queries
+    std::vector<std::string_view> served_stops;
+    for (StopId id = 0; id < catalogue.GetStopCount(); ++id) {
+        if (!catalogue.GetBusesByStop(id).empty()) {
+            served_stops.push_back(catalogue.GetStopName(id));
+        }
+    }
+
+    std::mt19937 random(SEED + 1);
+    std::uniform_int_distribution<size_t> any_stop(0, served_stops.size() - 1);
+    Queries queries;
+    for (size_t i = 0; i < query_count; ++i) {
+        queries.push_back({ served_stops[any_stop(random)], served_stops[any_stop(random)] });
+    }
+
+    start = std::chrono::steady_clock::now();
+    const auto times = RunQueries(router, queries);
+    const double query_time = GetSecondsSince(start);
+
+    size_t found = 0;
+    double total_time = 0;
+    for (const double time : times) {
+        if (time >= 0) {
+            ++found;
+            total_time += time;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+        << argv[1] << ": " << stop_count << " stops, " << bus_count << " buses, " << query_count << " queries\n"
+        << "build " << build_time << " s, queries " << query_time << " s ("
+        << query_time * 1e6 / std::max<size_t>(query_count, 1) << " us/query), peak RSS " << GetPeakRss() / 1024 << " MB\n"
+        << "checksum: " << found << " routes, total time " << std::setprecision(1) << total_time << " min\n";
+
+    start = std::chrono::steady_clock::now();
+    router.Customize(2, 17);
+    const double customize_time = GetSecondsSince(start);
+
+    settings.bus_wait_time = 2;
+    settings.bus_velocity = 17;
+    start = std::chrono::steady_clock::now();
+    router::TransportRouter fresh_router(catalogue, settings);
+    const double fresh_build_time = GetSecondsSince(start);
+
+    const auto customized_times = RunQueries(router, queries);
+    const auto fresh_times = RunQueries(fresh_router, queries);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (std::abs(customized_times[i] - fresh_times[i]) > 1e-6) {
+            ++mismatches;
+        }
+    }
+
+    std::cout << std::setprecision(3) << "customize " << customize_time << " s, fresh build " << fresh_build_time << " s, "
+        << mismatches << " of " << queries.size() << " routes differ\n";
+    return mismatches == 0 ? 0 : 1;
+}
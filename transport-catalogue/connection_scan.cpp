@@ -0,0 +1,105 @@
+#include "connection_scan.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace router {
+
+    namespace {
+
+        const double UNREACHED = std::numeric_limits<double>::infinity();
+
+    }
+
+    ConnectionScan::ConnectionScan(const catalogue::TransportCatalogue& catalogue, double meters_per_minute)
+        : stop_count_(catalogue.GetStopCount())
+    {
+        for (const auto& bus : catalogue.GetBuses()) {
+            const auto bus_stops = catalogue.GetBusStopIds(bus->id);
+            if (bus->trip_start_times.empty() || bus_stops.size() < 2) {
+                continue;
+            }
+
+            const size_t prefix_offset = prefix_distances_.size();
+            const auto prefix = catalogue.GetBusRoadPrefix(bus->id);
+            prefix_distances_.insert(prefix_distances_.end(), prefix.begin(), prefix.end());
+
+            for (const double start_time : bus->trip_start_times) {
+                const TripId trip = static_cast<TripId>(trips_.size());
+                trips_.push_back({ bus, prefix_offset });
+                for (size_t i = 0; i + 1 < bus_stops.size(); ++i) {
+                    connections_.push_back({
+                        start_time + prefix_distances_[prefix_offset + i] / meters_per_minute,
+                        start_time + prefix_distances_[prefix_offset + i + 1] / meters_per_minute,
+                        bus_stops[i], bus_stops[i + 1], trip, static_cast<uint32_t>(i) });
+                }
+            }
+        }
+
+        // Ties on departure go to the earlier arrival, so a zero-length connection is scanned
+        // before the ones that leave from where it arrives
+        std::sort(connections_.begin(), connections_.end(), [](const Connection& lhs, const Connection& rhs) {
+            if (lhs.departure != rhs.departure) {
+                return lhs.departure < rhs.departure;
+            }
+            if (lhs.arrival != rhs.arrival) {
+                return lhs.arrival < rhs.arrival;
+            }
+            return lhs.trip < rhs.trip || (lhs.trip == rhs.trip && lhs.position < rhs.position);
+        });
+    }
+
+    std::optional<TimetableJourney> ConnectionScan::ComputeJourney(const Stop* from, const Stop* to, double departure_time) const {
+        // Per stop: the earliest arrival and the connections that entered and left the trip reaching it
+        struct Label {
+            double arrival = UNREACHED;
+            ConnectionId enter = NO_CONNECTION;
+            ConnectionId exit = NO_CONNECTION;
+        };
+
+        const StopId source = from->id;
+        const StopId target = to->id;
+
+        std::vector<Label> labels(stop_count_);
+        std::vector<ConnectionId> trip_enter(trips_.size(), NO_CONNECTION);
+        labels[source].arrival = departure_time;
+
+        const auto first = std::lower_bound(connections_.begin(), connections_.end(), departure_time, [](const Connection& connection, double time) {
+            return connection.departure < time;
+        });
+
+        for (auto it = first; it != connections_.end(); ++it) {
+            const Connection& connection = *it;
+            if (connection.departure >= labels[target].arrival) {
+                break;
+            }
+
+            const ConnectionId id = static_cast<ConnectionId>(it - connections_.begin());
+            ConnectionId& enter = trip_enter[connection.trip];
+            if (enter == NO_CONNECTION && labels[connection.from].arrival <= connection.departure) {
+                enter = id;
+            }
+            if (enter != NO_CONNECTION && connection.arrival < labels[connection.to].arrival) {
+                labels[connection.to] = { connection.arrival, enter, id };
+            }
+        }
+
+        if (labels[target].arrival == UNREACHED) {
+            return std::nullopt;
+        }
+
+        TimetableJourney journey;
+        for (StopId stop = target; stop != source;) {
+            const Connection& enter = connections_[labels[stop].enter];
+            const Connection& exit = connections_[labels[stop].exit];
+            const Trip& trip = trips_[enter.trip];
+            journey.push_back({ trip.bus, enter.position, exit.position + 1,
+                prefix_distances_[trip.prefix_offset + exit.position + 1] - prefix_distances_[trip.prefix_offset + enter.position],
+                enter.departure, exit.arrival });
+            stop = enter.from;
+        }
+        std::reverse(journey.begin(), journey.end());
+        return journey;
+    }
+
+}
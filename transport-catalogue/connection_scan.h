@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "domain.h"
+#include "transport_catalogue.h"
+
+namespace router {
+
+    // One ride of a timetabled journey: route positions `board` to `alight` of the bus,
+    // leaving at `departure` and arriving at `arrival` (minutes)
+    struct TimetableLeg {
+        const Bus* bus;
+        size_t board;
+        size_t alight;
+        int distance;
+        double departure;
+        double arrival;
+    };
+
+    using TimetableJourney = std::vector<TimetableLeg>;
+
+    // Earliest-arrival routing on bus timetables with the Connection Scan Algorithm.
+    // Every trip of every timetabled bus is split into elementary connections (one stop to the
+    // next) kept in one array sorted by departure. A query scans it once from the departure time
+    // and stops as soon as no connection can arrive earlier at the target.
+    // Waiting is whatever time passes between reaching a stop and the departure of the trip.
+    class ConnectionScan {
+    public:
+        ConnectionScan(const catalogue::TransportCatalogue& catalogue, double meters_per_minute);
+
+        // Earliest-arriving journey from `from` leaving no earlier than departure_time;
+        // std::nullopt if `to` cannot be reached
+        std::optional<TimetableJourney> ComputeJourney(const Stop* from, const Stop* to, double departure_time) const;
+
+        size_t GetConnectionCount() const {
+            return connections_.size();
+        }
+
+    private:
+        using TripId = uint32_t;
+        using ConnectionId = uint32_t;
+
+        struct Connection {
+            double departure;
+            double arrival;
+            StopId from;
+            StopId to;
+            TripId trip;
+            // Position of `from` on the bus route
+            uint32_t position;
+        };
+
+        struct Trip {
+            const Bus* bus;
+            size_t prefix_offset;
+        };
+
+        static constexpr ConnectionId NO_CONNECTION = static_cast<ConnectionId>(-1);
+
+        size_t stop_count_;
+        std::vector<Trip> trips_;
+        // Road distance from the first stop, per bus with a timetable; Trip::prefix_offset points here
+        std::vector<int> prefix_distances_;
+        std::vector<Connection> connections_;
+    };
+
+}
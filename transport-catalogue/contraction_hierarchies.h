@@ -0,0 +1,666 @@
+#pragma once
+
+#include "graph.h"
+#include "dijkstra_router.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Graph edge or shortcut of a contraction hierarchy; a shortcut is made of two shorter arcs
+    template <typename Weight>
+    struct HierarchyArc {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        size_t first_child;
+        size_t second_child;
+    };
+
+    // Higher-ranked neighbour of a vertex, reached over `arc`
+    template <typename Weight>
+    struct HierarchyLink {
+        VertexId vertex;
+        Weight weight;
+        size_t arc;
+    };
+
+    // A contracted hierarchy as flat arrays, so it can be saved and loaded without contracting
+    // again. The graph edges are not stored: they are the first arcs of the loaded hierarchy.
+    template <typename Weight>
+    struct HierarchyData {
+        // Arcs after the graph edges, in id order
+        std::vector<HierarchyArc<Weight>> shortcuts;
+        // Round r contracted round_vertices[round_offsets[r]..round_offsets[r + 1]]
+        std::vector<size_t> round_offsets;
+        std::vector<VertexId> round_vertices;
+        // Upward links of vertex v are upward_out_links[upward_out_offsets[v]..upward_out_offsets[v + 1]],
+        // upward_in alike
+        std::vector<size_t> upward_out_offsets;
+        std::vector<HierarchyLink<Weight>> upward_out_links;
+        std::vector<size_t> upward_in_offsets;
+        std::vector<HierarchyLink<Weight>> upward_in_links;
+    };
+
+    // Contraction Hierarchies over a DirectedWeightedGraph.
+    // Vertices are contracted in rounds: every round takes an independent set of vertices with
+    // locally minimal priority, runs their witness searches in parallel and applies the shortcuts
+    // in vertex order, so the hierarchy does not depend on the thread count.
+    // Queries are bidirectional upward searches; shortcuts are unpacked back into graph edge ids.
+    // Graph is DirectedWeightedGraph or its frozen CsrGraph copy.
+    // The contraction rounds are kept, so new weights on the same topology are customized by
+    // replaying that order: only the witness searches run again, no priorities.
+    template <typename Weight, typename Graph = DirectedWeightedGraph<Weight>>
+    class ContractionHierarchy {
+    private:
+        using ArcId = size_t;
+
+    public:
+        using Data = HierarchyData<Weight>;
+
+        ContractionHierarchy(const Graph& graph, size_t thread_count);
+        // The hierarchy GetData() returned for this graph; throws std::invalid_argument if the
+        // data cannot belong to it
+        ContractionHierarchy(const Graph& graph, Data data, size_t thread_count);
+
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        // Rebuilds the hierarchy for new weights of the same graph in the recorded vertex order
+        void Customize(const Graph& graph);
+
+        // Settled vertices and the other counters add up both directions
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+        size_t GetShortcutCount() const {
+            return arcs_.size() - original_edge_count_;
+        }
+
+        Data GetData() const;
+
+    private:
+        // Arcs with id < original_edge_count_ are the graph edges themselves,
+        // the rest are shortcuts made of two shorter arcs
+        using Arc = HierarchyArc<Weight>;
+        using Link = HierarchyLink<Weight>;
+        using Links = std::vector<std::vector<Link>>;
+
+        struct Shortcut {
+            VertexId from;
+            VertexId to;
+            Weight weight;
+            ArcId first_child;
+            ArcId second_child;
+        };
+
+        enum VertexStatus : uint8_t {
+            ACTIVE,
+            CONTRACTING,
+            CONTRACTED
+        };
+
+        struct SearchState {
+            Weight weight;
+            ArcId prev_arc;
+            uint32_t stamp = 0;
+            uint32_t settled_stamp = 0;
+            uint32_t target_stamp = 0;
+        };
+
+        struct SearchSpace {
+            std::vector<SearchState> states;
+            uint32_t stamp = 0;
+
+            void Reset(size_t vertex_count) {
+                if (states.size() < vertex_count) {
+                    states.resize(vertex_count);
+                }
+                if (++stamp == 0) {
+                    for (auto& state : states) {
+                        state.stamp = 0;
+                        state.settled_stamp = 0;
+                        state.target_stamp = 0;
+                    }
+                    stamp = 1;
+                }
+            }
+
+            bool IsReached(VertexId vertex) const {
+                return states[vertex].stamp == stamp;
+            }
+        };
+
+        using QueueElem = std::pair<Weight, VertexId>;
+        using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<QueueElem>>;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr ArcId NO_ARC = static_cast<ArcId>(-1);
+        // Witness searches only prove shortcuts unnecessary, so a cut-off search costs
+        // extra shortcuts, never correctness. Priorities are estimates and get a tighter limit.
+        static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+        static constexpr size_t PRIORITY_SETTLE_LIMIT = 5;
+
+        class Builder;
+
+        void UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const;
+        void InitArcs(const Graph& graph);
+
+        template <typename T>
+        static void Flatten(const std::vector<std::vector<T>>& lists, std::vector<size_t>& offsets, std::vector<T>& items);
+        // Throws std::invalid_argument on offsets that do not cover `items` in order
+        template <typename T>
+        static std::vector<std::vector<T>> Unflatten(const std::vector<size_t>& offsets, const std::vector<T>& items);
+
+        size_t thread_count_;
+        size_t original_edge_count_ = 0;
+        // Vertices contracted together, round by round
+        std::vector<std::vector<VertexId>> rounds_;
+        std::vector<Arc> arcs_;
+        Links upward_out_;
+        Links upward_in_;
+    };
+
+    template <typename Weight, typename Graph>
+    class ContractionHierarchy<Weight, Graph>::Builder {
+    public:
+        Builder(ContractionHierarchy& hierarchy, size_t vertex_count, size_t thread_count)
+            : hierarchy_(hierarchy)
+            , thread_count_(thread_count)
+            , out_(vertex_count)
+            , in_(vertex_count)
+            , status_(vertex_count, VertexStatus::ACTIVE)
+            , priority_(vertex_count, 0)
+            , contracted_neighbours_(vertex_count, 0)
+        {
+        }
+
+        void AddArc(ArcId arc_id) {
+            const Arc& arc = hierarchy_.arcs_[arc_id];
+            if (arc.from == arc.to) {
+                return;
+            }
+            auto existing = FindLink(out_[arc.from], arc.to);
+            if (existing == out_[arc.from].end()) {
+                out_[arc.from].push_back({ arc.to, arc.weight, arc_id });
+                in_[arc.to].push_back({ arc.from, arc.weight, arc_id });
+            }
+            else if (arc.weight < existing->weight) {
+                *existing = { arc.to, arc.weight, arc_id };
+                *FindLink(in_[arc.to], arc.from) = { arc.from, arc.weight, arc_id };
+            }
+        }
+
+        void Run() {
+            const size_t vertex_count = out_.size();
+            hierarchy_.upward_out_.assign(vertex_count, {});
+            hierarchy_.upward_in_.assign(vertex_count, {});
+            hierarchy_.rounds_.clear();
+
+            std::vector<VertexId> remaining(vertex_count);
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                remaining[vertex] = vertex;
+            }
+            std::vector<VertexId> dirty = remaining;
+
+            while (!remaining.empty()) {
+                parallel::ForEachIndex(dirty.size(), thread_count_, [&](size_t i) {
+                    priority_[dirty[i]] = ComputePriority(dirty[i]);
+                });
+
+                std::vector<char> selected(remaining.size(), 0);
+                parallel::ForEachIndex(remaining.size(), thread_count_, [&](size_t i) {
+                    selected[i] = IsLocalMinimum(remaining[i]);
+                });
+
+                std::vector<VertexId> batch;
+                std::vector<VertexId> rest;
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    (selected[i] ? batch : rest).push_back(remaining[i]);
+                }
+
+                dirty.clear();
+                ContractBatch(batch, dirty);
+                std::sort(dirty.begin(), dirty.end());
+                dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+                remaining = std::move(rest);
+            }
+        }
+
+        // Contracts in the order of `rounds`. New weights may leave different shortcuts, so two
+        // vertices of a recorded round can now be neighbours: the later one waits for a round of its own.
+        void Replay(const std::vector<std::vector<VertexId>>& rounds) {
+            const size_t vertex_count = out_.size();
+            hierarchy_.upward_out_.assign(vertex_count, {});
+            hierarchy_.upward_in_.assign(vertex_count, {});
+            hierarchy_.rounds_.clear();
+
+            std::vector<char> in_batch(vertex_count, 0);
+            std::vector<VertexId> dirty;
+            for (std::vector<VertexId> pending : rounds) {
+                while (!pending.empty()) {
+                    std::vector<VertexId> batch;
+                    std::vector<VertexId> rest;
+                    for (const VertexId vertex : pending) {
+                        const bool is_independent = std::none_of(out_[vertex].begin(), out_[vertex].end(), [&](const Link& link) {
+                                return in_batch[link.vertex];
+                            }) && std::none_of(in_[vertex].begin(), in_[vertex].end(), [&](const Link& link) {
+                                return in_batch[link.vertex];
+                            });
+                        if (is_independent) {
+                            in_batch[vertex] = 1;
+                            batch.push_back(vertex);
+                        }
+                        else {
+                            rest.push_back(vertex);
+                        }
+                    }
+
+                    for (const VertexId vertex : batch) {
+                        in_batch[vertex] = 0;
+                    }
+                    dirty.clear();
+                    ContractBatch(batch, dirty);
+                    pending = std::move(rest);
+                }
+            }
+        }
+
+    private:
+        void ContractBatch(const std::vector<VertexId>& batch, std::vector<VertexId>& dirty) {
+            for (const VertexId vertex : batch) {
+                status_[vertex] = VertexStatus::CONTRACTING;
+            }
+            std::vector<std::vector<Shortcut>> shortcuts(batch.size());
+            parallel::ForEachIndex(batch.size(), thread_count_, [&](size_t i) {
+                shortcuts[i] = FindShortcuts(batch[i], WITNESS_SETTLE_LIMIT);
+            });
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                Contract(batch[i], shortcuts[i], dirty);
+            }
+            hierarchy_.rounds_.push_back(batch);
+        }
+
+        static typename std::vector<Link>::iterator FindLink(std::vector<Link>& links, VertexId vertex) {
+            return std::find_if(links.begin(), links.end(), [vertex](const Link& link) {
+                return link.vertex == vertex;
+            });
+        }
+
+        static void EraseLink(std::vector<Link>& links, VertexId vertex) {
+            links.erase(std::remove_if(links.begin(), links.end(), [vertex](const Link& link) {
+                return link.vertex == vertex;
+                }), links.end());
+        }
+
+        // Bounded Dijkstra from source that never enters skipped or CONTRACTING vertices.
+        // Stops once every out-neighbour of skipped is settled or max_weight is exceeded.
+        void WitnessSearch(SearchSpace& space, VertexId source, VertexId skipped, Weight max_weight, size_t settle_limit) const {
+            space.Reset(out_.size());
+            auto& states = space.states;
+
+            size_t targets_left = 0;
+            for (const Link& link : out_[skipped]) {
+                if (link.vertex != source && status_[link.vertex] == VertexStatus::ACTIVE) {
+                    states[link.vertex].target_stamp = space.stamp;
+                    ++targets_left;
+                }
+            }
+
+            Queue queue;
+            states[source] = { ZERO_WEIGHT, NO_ARC, space.stamp, 0, states[source].target_stamp };
+            queue.push({ ZERO_WEIGHT, source });
+
+            size_t settled = 0;
+            while (!queue.empty() && targets_left > 0 && settled < settle_limit) {
+                const auto [weight, vertex] = queue.top();
+                queue.pop();
+                if (weight > max_weight) {
+                    break;
+                }
+                auto& state = states[vertex];
+                if (state.settled_stamp == space.stamp || state.weight < weight) {
+                    continue;
+                }
+                state.settled_stamp = space.stamp;
+                ++settled;
+                if (state.target_stamp == space.stamp) {
+                    --targets_left;
+                }
+
+                for (const Link& link : out_[vertex]) {
+                    if (link.vertex == skipped || status_[link.vertex] != VertexStatus::ACTIVE) {
+                        continue;
+                    }
+                    auto& next = states[link.vertex];
+                    const Weight candidate = weight + link.weight;
+                    if (next.stamp != space.stamp) {
+                        next.weight = candidate;
+                        next.prev_arc = NO_ARC;
+                        next.stamp = space.stamp;
+                        queue.push({ candidate, link.vertex });
+                    }
+                    else if (next.settled_stamp != space.stamp && candidate < next.weight) {
+                        next.weight = candidate;
+                        queue.push({ candidate, link.vertex });
+                    }
+                }
+            }
+        }
+
+        std::vector<Shortcut> FindShortcuts(VertexId vertex, size_t settle_limit) const {
+            thread_local SearchSpace space;
+            std::vector<Shortcut> result;
+
+            Weight max_out = ZERO_WEIGHT;
+            for (const Link& link : out_[vertex]) {
+                max_out = std::max(max_out, link.weight);
+            }
+
+            for (const Link& in_link : in_[vertex]) {
+                if (status_[in_link.vertex] != VertexStatus::ACTIVE) {
+                    continue;
+                }
+                WitnessSearch(space, in_link.vertex, vertex, in_link.weight + max_out, settle_limit);
+
+                for (const Link& out_link : out_[vertex]) {
+                    if (out_link.vertex == in_link.vertex || status_[out_link.vertex] != VertexStatus::ACTIVE) {
+                        continue;
+                    }
+                    const Weight candidate = in_link.weight + out_link.weight;
+                    if (space.IsReached(out_link.vertex) && !(candidate < space.states[out_link.vertex].weight)) {
+                        continue;
+                    }
+                    result.push_back({ in_link.vertex, out_link.vertex, candidate, in_link.arc, out_link.arc });
+                }
+            }
+            return result;
+        }
+
+        int64_t ComputePriority(VertexId vertex) const {
+            const int64_t shortcut_count = static_cast<int64_t>(FindShortcuts(vertex, PRIORITY_SETTLE_LIMIT).size());
+            const int64_t degree = static_cast<int64_t>(in_[vertex].size() + out_[vertex].size());
+            return shortcut_count - degree + contracted_neighbours_[vertex];
+        }
+
+        bool IsLocalMinimum(VertexId vertex) const {
+            const auto key = std::make_pair(priority_[vertex], vertex);
+            for (const auto* links : { &out_[vertex], &in_[vertex] }) {
+                for (const Link& link : *links) {
+                    if (std::make_pair(priority_[link.vertex], link.vertex) < key) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void Contract(VertexId vertex, const std::vector<Shortcut>& shortcuts, std::vector<VertexId>& dirty) {
+            hierarchy_.upward_out_[vertex] = out_[vertex];
+            for (const Link& link : in_[vertex]) {
+                hierarchy_.upward_in_[vertex].push_back(link);
+            }
+
+            for (const Link& link : out_[vertex]) {
+                EraseLink(in_[link.vertex], vertex);
+                ++contracted_neighbours_[link.vertex];
+                dirty.push_back(link.vertex);
+            }
+            for (const Link& link : in_[vertex]) {
+                EraseLink(out_[link.vertex], vertex);
+                ++contracted_neighbours_[link.vertex];
+                dirty.push_back(link.vertex);
+            }
+            out_[vertex] = {};
+            in_[vertex] = {};
+            status_[vertex] = VertexStatus::CONTRACTED;
+
+            for (const Shortcut& shortcut : shortcuts) {
+                hierarchy_.arcs_.push_back({ shortcut.from, shortcut.to, shortcut.weight, shortcut.first_child, shortcut.second_child });
+                AddArc(hierarchy_.arcs_.size() - 1);
+            }
+        }
+
+        ContractionHierarchy& hierarchy_;
+        size_t thread_count_;
+        Links out_;
+        Links in_;
+        std::vector<VertexStatus> status_;
+        std::vector<int64_t> priority_;
+        std::vector<int64_t> contracted_neighbours_;
+    };
+
+    template <typename Weight, typename Graph>
+    ContractionHierarchy<Weight, Graph>::ContractionHierarchy(const Graph& graph, size_t thread_count)
+        : thread_count_(thread_count)
+    {
+        InitArcs(graph);
+        Builder builder(*this, graph.GetVertexCount(), thread_count_);
+        for (ArcId arc_id = 0; arc_id < original_edge_count_; ++arc_id) {
+            builder.AddArc(arc_id);
+        }
+        builder.Run();
+    }
+
+    template <typename Weight, typename Graph>
+    ContractionHierarchy<Weight, Graph>::ContractionHierarchy(const Graph& graph, Data data, size_t thread_count)
+        : thread_count_(thread_count)
+    {
+        if (data.upward_out_offsets.size() != graph.GetVertexCount() + 1 || data.upward_in_offsets.size() != graph.GetVertexCount() + 1) {
+            throw std::invalid_argument("Hierarchy data should have links for every graph vertex");
+        }
+        InitArcs(graph);
+        for (const Arc& shortcut : data.shortcuts) {
+            if (shortcut.first_child >= arcs_.size() || shortcut.second_child >= arcs_.size()) {
+                throw std::invalid_argument("Shortcut should be made of arcs before it");
+            }
+            arcs_.push_back(shortcut);
+        }
+
+        rounds_ = Unflatten(data.round_offsets, data.round_vertices);
+        upward_out_ = Unflatten(data.upward_out_offsets, data.upward_out_links);
+        upward_in_ = Unflatten(data.upward_in_offsets, data.upward_in_links);
+        for (const Links* links : { &upward_out_, &upward_in_ }) {
+            for (const auto& vertex_links : *links) {
+                for (const Link& link : vertex_links) {
+                    if (link.vertex >= graph.GetVertexCount() || link.arc >= arcs_.size()) {
+                        throw std::invalid_argument("Hierarchy link should lead to a graph vertex over a known arc");
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    typename ContractionHierarchy<Weight, Graph>::Data ContractionHierarchy<Weight, Graph>::GetData() const {
+        Data data;
+        data.shortcuts.assign(arcs_.begin() + original_edge_count_, arcs_.end());
+        Flatten(rounds_, data.round_offsets, data.round_vertices);
+        Flatten(upward_out_, data.upward_out_offsets, data.upward_out_links);
+        Flatten(upward_in_, data.upward_in_offsets, data.upward_in_links);
+        return data;
+    }
+
+    template <typename Weight, typename Graph>
+    template <typename T>
+    void ContractionHierarchy<Weight, Graph>::Flatten(const std::vector<std::vector<T>>& lists, std::vector<size_t>& offsets, std::vector<T>& items) {
+        offsets.assign(1, 0);
+        for (const auto& list : lists) {
+            items.insert(items.end(), list.begin(), list.end());
+            offsets.push_back(items.size());
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    template <typename T>
+    std::vector<std::vector<T>> ContractionHierarchy<Weight, Graph>::Unflatten(const std::vector<size_t>& offsets, const std::vector<T>& items) {
+        if (offsets.empty() || offsets.front() != 0 || offsets.back() != items.size()) {
+            throw std::invalid_argument("Offsets should cover every item");
+        }
+        std::vector<std::vector<T>> lists;
+        lists.reserve(offsets.size() - 1);
+        for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+            if (offsets[i] > offsets[i + 1]) {
+                throw std::invalid_argument("Offsets should not decrease");
+            }
+            lists.emplace_back(items.begin() + offsets[i], items.begin() + offsets[i + 1]);
+        }
+        return lists;
+    }
+
+    template <typename Weight, typename Graph>
+    void ContractionHierarchy<Weight, Graph>::Customize(const Graph& graph) {
+        if (graph.GetVertexCount() != upward_out_.size() || graph.GetEdgeCount() != original_edge_count_) {
+            throw std::invalid_argument("Customization needs the graph the hierarchy was built on");
+        }
+        InitArcs(graph);
+        const std::vector<std::vector<VertexId>> rounds = std::move(rounds_);
+        Builder builder(*this, graph.GetVertexCount(), thread_count_);
+        for (ArcId arc_id = 0; arc_id < original_edge_count_; ++arc_id) {
+            builder.AddArc(arc_id);
+        }
+        builder.Replay(rounds);
+    }
+
+    template <typename Weight, typename Graph>
+    void ContractionHierarchy<Weight, Graph>::InitArcs(const Graph& graph) {
+        original_edge_count_ = graph.GetEdgeCount();
+        arcs_.clear();
+        arcs_.reserve(original_edge_count_);
+        for (EdgeId edge_id = 0; edge_id < original_edge_count_; ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            arcs_.push_back({ edge.from, edge.to, edge.weight, NO_ARC, NO_ARC });
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    std::optional<typename ContractionHierarchy<Weight, Graph>::RouteInfo> ContractionHierarchy<Weight, Graph>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+        thread_local SearchSpace forward_space;
+        thread_local SearchSpace backward_space;
+        const size_t vertex_count = upward_out_.size();
+        forward_space.Reset(vertex_count);
+        backward_space.Reset(vertex_count);
+
+        SearchSpace* spaces[2] = { &forward_space, &backward_space };
+        const Links* links[2] = { &upward_out_, &upward_in_ };
+        Queue queues[2];
+
+        for (int side = 0; side < 2; ++side) {
+            const VertexId source = side == 0 ? from : to;
+            spaces[side]->states[source] = { ZERO_WEIGHT, NO_ARC, spaces[side]->stamp, 0, 0 };
+            queues[side].push({ ZERO_WEIGHT, source });
+        }
+
+        std::optional<Weight> best;
+        VertexId meeting = from;
+
+        SearchStats search_stats;
+        ROUTER_INSTRUMENT(search_stats.heap_pushes += 2;)
+        while (true) {
+            int side = -1;
+            for (int candidate = 0; candidate < 2; ++candidate) {
+                if (queues[candidate].empty() || (best && !(queues[candidate].top().first < *best))) {
+                    continue;
+                }
+                if (side == -1 || queues[candidate].top().first < queues[side].top().first) {
+                    side = candidate;
+                }
+            }
+            if (side == -1) {
+                break;
+            }
+
+            SearchSpace& space = *spaces[side];
+            const SearchSpace& other = *spaces[1 - side];
+            const auto [weight, vertex] = queues[side].top();
+            queues[side].pop();
+            ROUTER_INSTRUMENT(++search_stats.heap_pops;)
+
+            auto& state = space.states[vertex];
+            if (state.settled_stamp == space.stamp || state.weight < weight) {
+                continue;
+            }
+            state.settled_stamp = space.stamp;
+            ++search_stats.settled_vertices;
+
+            if (other.IsReached(vertex)) {
+                const Weight total = weight + other.states[vertex].weight;
+                if (!best || total < *best) {
+                    best = total;
+                    meeting = vertex;
+                }
+            }
+
+            for (const Link& link : (*links[side])[vertex]) {
+                ROUTER_INSTRUMENT(++search_stats.relaxed_edges;)
+                auto& next = space.states[link.vertex];
+                const Weight candidate = weight + link.weight;
+                if (next.stamp != space.stamp) {
+                    next = { candidate, link.arc, space.stamp, 0, 0 };
+                    queues[side].push({ candidate, link.vertex });
+                    ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+                }
+                else if (next.settled_stamp != space.stamp && candidate < next.weight) {
+                    next.weight = candidate;
+                    next.prev_arc = link.arc;
+                    queues[side].push({ candidate, link.vertex });
+                    ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+                }
+            }
+        }
+
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+        if (!best) {
+            return std::nullopt;
+        }
+
+        std::vector<ArcId> forward_arcs;
+        for (ArcId arc = forward_space.states[meeting].prev_arc; arc != NO_ARC; arc = forward_space.states[arcs_[arc].from].prev_arc) {
+            forward_arcs.push_back(arc);
+        }
+        std::reverse(forward_arcs.begin(), forward_arcs.end());
+        for (ArcId arc = backward_space.states[meeting].prev_arc; arc != NO_ARC; arc = backward_space.states[arcs_[arc].to].prev_arc) {
+            forward_arcs.push_back(arc);
+        }
+
+        std::vector<EdgeId> edges;
+        for (const ArcId arc : forward_arcs) {
+            UnpackArc(arc, edges);
+        }
+        return RouteInfo{ *best, std::move(edges) };
+    }
+
+    template <typename Weight, typename Graph>
+    void ContractionHierarchy<Weight, Graph>::UnpackArc(ArcId arc, std::vector<EdgeId>& edges) const {
+        std::vector<ArcId> stack = { arc };
+        while (!stack.empty()) {
+            const ArcId current = stack.back();
+            stack.pop_back();
+            if (current < original_edge_count_) {
+                edges.push_back(current);
+            }
+            else {
+                stack.push_back(arcs_[current].second_child);
+                stack.push_back(arcs_[current].first_child);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "graph.h"
+#include "ranges.h"
+
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Frozen compressed-sparse-row copy of a DirectedWeightedGraph.
+    // Outgoing edges of a vertex occupy one contiguous slice of targets_/weights_/edge_ids_,
+    // in the same order as DirectedWeightedGraph::GetIncidentEdges. Edge ids are preserved.
+    template <typename Weight>
+    class CsrGraph {
+    private:
+        using IncidentEdgesRange = ranges::Range<typename std::vector<EdgeId>::const_iterator>;
+
+    public:
+        CsrGraph() = default;
+        explicit CsrGraph(const DirectedWeightedGraph<Weight>& graph);
+
+        size_t GetVertexCount() const {
+            return offsets_.size() - 1;
+        }
+
+        size_t GetEdgeCount() const {
+            return edge_ids_.size();
+        }
+
+        Edge<Weight> GetEdge(EdgeId edge_id) const {
+            const size_t position = position_by_edge_.at(edge_id);
+            return { sources_[edge_id], targets_[position], weights_[position] };
+        }
+
+        IncidentEdgesRange GetIncidentEdges(VertexId vertex) const {
+            return { edge_ids_.begin() + offsets_.at(vertex), edge_ids_.begin() + offsets_.at(vertex + 1) };
+        }
+
+        // Topology stays frozen, only the weight of an edge can change
+        void SetEdgeWeight(EdgeId edge_id, Weight weight) {
+            weights_[position_by_edge_.at(edge_id)] = weight;
+        }
+
+        // Walks the outgoing slice of vertex without touching per-edge records:
+        // func(edge_id, to, weight)
+        template <typename Func>
+        void ForEachOutgoingEdge(VertexId vertex, Func&& func) const {
+            const size_t end = offsets_[vertex + 1];
+            for (size_t position = offsets_[vertex]; position < end; ++position) {
+                func(edge_ids_[position], targets_[position], weights_[position]);
+            }
+        }
+
+    private:
+        std::vector<size_t> offsets_ = { 0 };
+        std::vector<VertexId> targets_;
+        std::vector<Weight> weights_;
+        std::vector<EdgeId> edge_ids_;
+
+        std::vector<VertexId> sources_;
+        std::vector<size_t> position_by_edge_;
+    };
+
+    template <typename Weight>
+    CsrGraph<Weight>::CsrGraph(const DirectedWeightedGraph<Weight>& graph)
+        : offsets_(graph.GetVertexCount() + 1, 0)
+        , targets_(graph.GetEdgeCount())
+        , weights_(graph.GetEdgeCount())
+        , edge_ids_(graph.GetEdgeCount())
+        , sources_(graph.GetEdgeCount())
+        , position_by_edge_(graph.GetEdgeCount())
+    {
+        for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+            size_t position = offsets_[vertex];
+            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+                const auto& edge = graph.GetEdge(edge_id);
+                targets_[position] = edge.to;
+                weights_[position] = edge.weight;
+                edge_ids_[position] = edge_id;
+                sources_[edge_id] = vertex;
+                position_by_edge_[edge_id] = position;
+                ++position;
+            }
+            offsets_[vertex + 1] = position;
+        }
+    }
+
+    template <typename Weight, typename Func>
+    void ForEachOutgoingEdge(const DirectedWeightedGraph<Weight>& graph, VertexId vertex, Func&& func) {
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            func(edge_id, edge.to, edge.weight);
+        }
+    }
+
+    template <typename Weight, typename Func>
+    void ForEachOutgoingEdge(const CsrGraph<Weight>& graph, VertexId vertex, Func&& func) {
+        graph.ForEachOutgoingEdge(vertex, std::forward<Func>(func));
+    }
+
+}
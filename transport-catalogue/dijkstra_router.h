@@ -0,0 +1,269 @@
+#pragma once
+
+#include "graph.h"
+#include "csr_graph.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Search effort of one query, for comparing routers. Only settled_vertices is counted in
+    // every build; the rest needs TRANSPORT_ROUTER_INSTRUMENTATION (see instrumentation.h).
+    struct SearchStats {
+        size_t settled_vertices = 0;
+        size_t relaxed_edges = 0;
+        size_t heap_pushes = 0;
+        size_t heap_pops = 0;
+    };
+
+    // Query-time single-source router: no preprocessing, memory is O(V + E).
+    // Each query runs Dijkstra on a binary heap and stops as soon as the target is settled.
+    // Graph is DirectedWeightedGraph or its frozen CsrGraph copy.
+    template <typename Weight, typename Graph = DirectedWeightedGraph<Weight>>
+    class DijkstraRouter {
+    public:
+        explicit DijkstraRouter(const Graph& graph);
+
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+        // One search from `from` for all targets; it stops once every target is settled.
+        // Result i is the route to targets[i], the same one BuildRoute(from, targets[i]) returns.
+        std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets, SearchStats* stats = nullptr) const;
+        // Route weights only, from one search like BuildRoutes; std::nullopt for unreachable targets
+        std::vector<std::optional<Weight>> ComputeWeights(VertexId from, const std::vector<VertexId>& targets, SearchStats* stats = nullptr) const;
+        // Calls func(vertex, weight) for every vertex within max_weight of `from`, in order of
+        // weight; the search stops at the first vertex beyond max_weight
+        template <typename Func>
+        void ForEachReachableVertex(VertexId from, Weight max_weight, Func func, SearchStats* stats = nullptr) const;
+
+    private:
+        struct VertexState {
+            Weight weight;
+            std::optional<EdgeId> prev_edge;
+            uint32_t stamp = 0;
+            bool settled = false;
+            uint32_t target_stamp = 0;
+        };
+
+        // Per-thread scratch space: entries are valid only when their stamp matches the
+        // current query, so a query touches only the vertices it reaches.
+        struct SearchSpace {
+            std::vector<VertexState> states;
+            uint32_t stamp = 0;
+
+            void Reset(size_t vertex_count) {
+                if (states.size() < vertex_count) {
+                    states.resize(vertex_count);
+                }
+                if (++stamp == 0) {
+                    for (auto& state : states) {
+                        state.stamp = 0;
+                        state.target_stamp = 0;
+                    }
+                    stamp = 1;
+                }
+            }
+        };
+
+        using QueueElem = std::pair<Weight, VertexId>;
+        using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<QueueElem>>;
+
+        // Settles vertices from `from` until is_done(vertex) returns true for a settled vertex
+        template <typename IsDone>
+        SearchStats Search(SearchSpace& space, VertexId from, IsDone is_done) const;
+        // Searches until every target is settled
+        SearchStats SearchTargets(SearchSpace& space, VertexId from, const std::vector<VertexId>& targets) const;
+        std::optional<RouteInfo> ExtractRoute(const SearchSpace& space, VertexId to) const;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        const Graph& graph_;
+    };
+
+    template <typename Weight, typename Graph>
+    DijkstraRouter<Weight, Graph>::DijkstraRouter(const Graph& graph)
+        : graph_(graph)
+    {
+        for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+            if (graph_.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    template <typename IsDone>
+    SearchStats DijkstraRouter<Weight, Graph>::Search(SearchSpace& space, VertexId from, IsDone is_done) const {
+        auto& states = space.states;
+        const uint32_t stamp = space.stamp;
+
+        Queue queue;
+        auto& source = states.at(from);
+        source.weight = ZERO_WEIGHT;
+        source.prev_edge = std::nullopt;
+        source.stamp = stamp;
+        source.settled = false;
+        queue.push({ ZERO_WEIGHT, from });
+
+        SearchStats stats;
+        ROUTER_INSTRUMENT(++stats.heap_pushes;)
+        while (!queue.empty()) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            ROUTER_INSTRUMENT(++stats.heap_pops;)
+
+            auto& state = states[vertex];
+            if (state.settled || state.weight < weight) {
+                continue;
+            }
+            state.settled = true;
+            ++stats.settled_vertices;
+            if (is_done(vertex)) {
+                break;
+            }
+
+            ForEachOutgoingEdge(graph_, vertex, [&, weight = weight](EdgeId edge_id, VertexId next_vertex, Weight edge_weight) {
+                ROUTER_INSTRUMENT(++stats.relaxed_edges;)
+                auto& next = states[next_vertex];
+                const Weight candidate = weight + edge_weight;
+                if (next.stamp != stamp) {
+                    next.weight = candidate;
+                    next.prev_edge = edge_id;
+                    next.stamp = stamp;
+                    next.settled = false;
+                    queue.push({ candidate, next_vertex });
+                    ROUTER_INSTRUMENT(++stats.heap_pushes;)
+                }
+                else if (!next.settled && candidate < next.weight) {
+                    next.weight = candidate;
+                    next.prev_edge = edge_id;
+                    queue.push({ candidate, next_vertex });
+                    ROUTER_INSTRUMENT(++stats.heap_pushes;)
+                }
+            });
+        }
+        return stats;
+    }
+
+    template <typename Weight, typename Graph>
+    std::optional<typename DijkstraRouter<Weight, Graph>::RouteInfo> DijkstraRouter<Weight, Graph>::ExtractRoute(const SearchSpace& space, VertexId to) const {
+        const auto& states = space.states;
+        const auto& target = states[to];
+        if (target.stamp != space.stamp || !target.settled) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (std::optional<EdgeId> edge_id = target.prev_edge; edge_id; edge_id = states[graph_.GetEdge(*edge_id).from].prev_edge) {
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ target.weight, std::move(edges) };
+    }
+
+    template <typename Weight, typename Graph>
+    std::optional<typename DijkstraRouter<Weight, Graph>::RouteInfo> DijkstraRouter<Weight, Graph>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        space.Reset(graph_.GetVertexCount());
+
+        const SearchStats search_stats = Search(space, from, [to](VertexId vertex) {
+            return vertex == to;
+        });
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+        return ExtractRoute(space, to);
+    }
+
+    template <typename Weight, typename Graph>
+    SearchStats DijkstraRouter<Weight, Graph>::SearchTargets(SearchSpace& space, VertexId from, const std::vector<VertexId>& targets) const {
+        space.Reset(graph_.GetVertexCount());
+        auto& states = space.states;
+        const uint32_t stamp = space.stamp;
+
+        // Targets are marked with the query stamp; duplicates are counted once
+        size_t targets_left = 0;
+        for (const VertexId target : targets) {
+            auto& state = states.at(target);
+            if (state.target_stamp != stamp) {
+                state.target_stamp = stamp;
+                ++targets_left;
+            }
+        }
+
+        return Search(space, from, [&](VertexId vertex) {
+            return states[vertex].target_stamp == stamp && --targets_left == 0;
+        });
+    }
+
+    template <typename Weight, typename Graph>
+    std::vector<std::optional<typename DijkstraRouter<Weight, Graph>::RouteInfo>> DijkstraRouter<Weight, Graph>::BuildRoutes(VertexId from, const std::vector<VertexId>& targets, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        const SearchStats search_stats = SearchTargets(space, from, targets);
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+
+        std::vector<std::optional<RouteInfo>> routes;
+        routes.reserve(targets.size());
+        for (const VertexId target : targets) {
+            routes.push_back(ExtractRoute(space, target));
+        }
+        return routes;
+    }
+
+    template <typename Weight, typename Graph>
+    std::vector<std::optional<Weight>> DijkstraRouter<Weight, Graph>::ComputeWeights(VertexId from, const std::vector<VertexId>& targets, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        const SearchStats search_stats = SearchTargets(space, from, targets);
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId target : targets) {
+            const auto& state = space.states[target];
+            if (state.stamp == space.stamp && state.settled) {
+                weights.push_back(state.weight);
+            }
+            else {
+                weights.push_back(std::nullopt);
+            }
+        }
+        return weights;
+    }
+
+    template <typename Weight, typename Graph>
+    template <typename Func>
+    void DijkstraRouter<Weight, Graph>::ForEachReachableVertex(VertexId from, Weight max_weight, Func func, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        space.Reset(graph_.GetVertexCount());
+        const auto& states = space.states;
+
+        const SearchStats search_stats = Search(space, from, [&](VertexId vertex) {
+            const Weight weight = states[vertex].weight;
+            if (max_weight < weight) {
+                return true;
+            }
+            func(vertex, weight);
+            return false;
+        });
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+    }
+
+}
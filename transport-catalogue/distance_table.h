@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+#include "domain.h"
+
+namespace catalogue {
+
+    struct DistanceEntry {
+        StopId from;
+        StopId to;
+        int distance;
+    };
+
+    // Road distances between stops in one flat open-addressing table with linear probing.
+    // A slot holds the directed (from, to) pair packed into 64 bits and the distance. The probe
+    // sequence starts from a mixed hash of the unordered pair, so both directions of a pair sit
+    // in the same run of slots and the "this direction, else the reverse one" lookup of the
+    // road distances is a single probe walk. Capacity is a power of two, at most half full.
+    class DistanceTable {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = DistanceEntry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = DistanceEntry;
+
+            Iterator(const DistanceTable* table, size_t slot)
+                : table_(table), slot_(slot)
+            {
+                SkipEmpty();
+            }
+
+            DistanceEntry operator*() const {
+                const Slot& slot = table_->slots_[slot_];
+                return { static_cast<StopId>(slot.key >> 32), static_cast<StopId>(slot.key), slot.distance };
+            }
+
+            Iterator& operator++() {
+                ++slot_;
+                SkipEmpty();
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator result = *this;
+                ++*this;
+                return result;
+            }
+
+            bool operator==(const Iterator& other) const {
+                return slot_ == other.slot_;
+            }
+
+        private:
+            void SkipEmpty() {
+                while (slot_ < table_->slots_.size() && table_->slots_[slot_].key == EMPTY) {
+                    ++slot_;
+                }
+            }
+
+            const DistanceTable* table_;
+            size_t slot_;
+        };
+
+        // Keeps the distance already stored for (from, to), like std::unordered_map::insert
+        bool Insert(StopId from, StopId to, int distance) {
+            if ((size_ + 1) * 2 > slots_.size()) {
+                Rehash(slots_.empty() ? MIN_CAPACITY : slots_.size() * 2);
+            }
+            const uint64_t key = Pack(from, to);
+            size_t slot = Home(from, to);
+            while (slots_[slot].key != EMPTY) {
+                if (slots_[slot].key == key) {
+                    return false;
+                }
+                slot = (slot + 1) & (slots_.size() - 1);
+            }
+            slots_[slot] = { key, distance };
+            ++size_;
+            return true;
+        }
+
+        // Distance set for this direction
+        std::optional<int> Find(StopId from, StopId to) const {
+            if (size_ == 0) {
+                return std::nullopt;
+            }
+            const uint64_t key = Pack(from, to);
+            for (size_t slot = Home(from, to); slots_[slot].key != EMPTY; slot = (slot + 1) & (slots_.size() - 1)) {
+                if (slots_[slot].key == key) {
+                    return slots_[slot].distance;
+                }
+            }
+            return std::nullopt;
+        }
+
+        // Distance set for this direction, else for the reverse one
+        std::optional<int> FindEither(StopId from, StopId to) const {
+            if (size_ == 0) {
+                return std::nullopt;
+            }
+            const uint64_t key = Pack(from, to);
+            const uint64_t reverse_key = Pack(to, from);
+            std::optional<int> reverse;
+            for (size_t slot = Home(from, to); slots_[slot].key != EMPTY; slot = (slot + 1) & (slots_.size() - 1)) {
+                if (slots_[slot].key == key) {
+                    return slots_[slot].distance;
+                }
+                if (slots_[slot].key == reverse_key) {
+                    reverse = slots_[slot].distance;
+                }
+            }
+            return reverse;
+        }
+
+        size_t GetSize() const {
+            return size_;
+        }
+
+        // Every stored distance, in slot order
+        Iterator begin() const {
+            return Iterator(this, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(this, slots_.size());
+        }
+
+    private:
+        struct Slot {
+            uint64_t key;
+            int distance;
+        };
+
+        static constexpr uint64_t EMPTY = UINT64_MAX;
+        static constexpr size_t MIN_CAPACITY = 16;
+
+        static uint64_t Pack(StopId from, StopId to) {
+            return (static_cast<uint64_t>(from) << 32) | to;
+        }
+
+        // splitmix64 finalizer over the unordered pair
+        size_t Home(StopId from, StopId to) const {
+            uint64_t hash = from < to ? Pack(from, to) : Pack(to, from);
+            hash ^= hash >> 30;
+            hash *= 0xbf58476d1ce4e5b9ull;
+            hash ^= hash >> 27;
+            hash *= 0x94d049bb133111ebull;
+            hash ^= hash >> 31;
+            return static_cast<size_t>(hash) & (slots_.size() - 1);
+        }
+
+        void Rehash(size_t capacity) {
+            std::vector<Slot> old_slots(capacity, Slot{ EMPTY, 0 });
+            old_slots.swap(slots_);
+            for (const Slot& old_slot : old_slots) {
+                if (old_slot.key == EMPTY) {
+                    continue;
+                }
+                size_t slot = Home(static_cast<StopId>(old_slot.key >> 32), static_cast<StopId>(old_slot.key));
+                while (slots_[slot].key != EMPTY) {
+                    slot = (slot + 1) & (slots_.size() - 1);
+                }
+                slots_[slot] = old_slot;
+            }
+        }
+
+        std::vector<Slot> slots_;
+        size_t size_ = 0;
+    };
+
+}
@@ -2,16 +2,27 @@
 
 #include "geo.h"
 
-#include <string>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
+// Dense indices in insertion order: the catalogue keeps per-stop and per-bus data in flat arrays by id
+using StopId = uint32_t;
+using BusId = uint32_t;
+
+// Names are views into the name arena of the catalogue that owns the object.
+// Coordinates and bus routes live only in the catalogue's arrays: GetStopCoordinates() and
+// GetBusStopIds() by id.
 struct Stop {
-	std::string name;
-	geo::Coordinates coords;
+	StopId id;
+	std::string_view name;
 };
 
 struct Bus {
-	std::string name;
-	std::vector<const Stop*> stops;
+	BusId id;
+	std::string_view name;
 	bool is_roundtrip;
+	// Optional timetable: departure of every trip from the first stop, in minutes, ascending.
+	// Arrivals at later stops follow from the road distances and bus_velocity.
+	std::vector<double> trip_start_times;
 };
\ No newline at end of file
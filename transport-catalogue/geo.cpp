@@ -2,6 +2,7 @@
 #include "geo.h"
 
 #include <cmath>
+#include <numeric>
 
 namespace geo {
 
@@ -20,4 +21,50 @@ namespace geo {
         return std::abs(value) < EPSILON;
     }
 
+    namespace {
+
+        void Bisect(const std::vector<Coordinates>& points, std::vector<size_t>::iterator begin, std::vector<size_t>::iterator end,
+            size_t max_cell_size, std::vector<uint32_t>& cells, uint32_t& cell_count) {
+            if (static_cast<size_t>(end - begin) <= max_cell_size) {
+                for (auto it = begin; it != end; ++it) {
+                    cells[*it] = cell_count;
+                }
+                ++cell_count;
+                return;
+            }
+
+            const auto [min_lat, max_lat] = std::minmax_element(begin, end, [&](size_t lhs, size_t rhs) {
+                return points[lhs].lat < points[rhs].lat;
+            });
+            const auto [min_lng, max_lng] = std::minmax_element(begin, end, [&](size_t lhs, size_t rhs) {
+                return points[lhs].lng < points[rhs].lng;
+            });
+            // A degree of longitude shrinks with the cosine of the latitude
+            static const double dr = 3.1415926535 / 180.;
+            const double height = points[*max_lat].lat - points[*min_lat].lat;
+            const double width = (points[*max_lng].lng - points[*min_lng].lng) * std::cos((points[*max_lat].lat + points[*min_lat].lat) / 2 * dr);
+            const bool by_lat = height >= width;
+
+            // Ties are broken by index, so the partition does not depend on the sort implementation
+            const auto middle = begin + (end - begin) / 2;
+            std::nth_element(begin, middle, end, [&](size_t lhs, size_t rhs) {
+                const double lhs_key = by_lat ? points[lhs].lat : points[lhs].lng;
+                const double rhs_key = by_lat ? points[rhs].lat : points[rhs].lng;
+                return lhs_key < rhs_key || (lhs_key == rhs_key && lhs < rhs);
+            });
+            Bisect(points, begin, middle, max_cell_size, cells, cell_count);
+            Bisect(points, middle, end, max_cell_size, cells, cell_count);
+        }
+
+    }
+
+    std::vector<uint32_t> PartitionByCoordinates(const std::vector<Coordinates>& points, size_t max_cell_size) {
+        std::vector<size_t> indices(points.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        std::vector<uint32_t> cells(points.size(), 0);
+        uint32_t cell_count = 0;
+        Bisect(points, indices.begin(), indices.end(), std::max<size_t>(max_cell_size, 1), cells, cell_count);
+        return cells;
+    }
+
 }  // namespace geo
\ No newline at end of file
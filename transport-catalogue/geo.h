@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 #include "svg.h"
 
@@ -23,6 +25,11 @@ namespace geo {
     inline const double EPSILON = 1e-6;
     bool IsZero(double value);
 
+    // Splits the points into cells of at most max_cell_size points by recursive bisection:
+    // every split cuts the wider side of the bounding box at the median. Returns the cell of
+    // every point; cells are numbered from 0 in order of creation.
+    std::vector<uint32_t> PartitionByCoordinates(const std::vector<Coordinates>& points, size_t max_cell_size);
+
     class SphereProjector {
     public:
         // points_begin  points_end       geo::Coordinates
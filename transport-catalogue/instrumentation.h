@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Query instrumentation of the routers. Built with -DTRANSPORT_ROUTER_INSTRUMENTATION, the
+// searches also count relaxed edges and heap operations and every route query is timed.
+// Without it each ROUTER_INSTRUMENT(...) statement is removed by the preprocessor, so the
+// search loops are exactly the uninstrumented ones.
+#ifdef TRANSPORT_ROUTER_INSTRUMENTATION
+#define ROUTER_INSTRUMENT(...) __VA_ARGS__
+#else
+#define ROUTER_INSTRUMENT(...)
+#endif
+
+namespace instrumentation {
+
+    inline constexpr bool ENABLED =
+#ifdef TRANSPORT_ROUTER_INSTRUMENTATION
+        true;
+#else
+        false;
+#endif
+
+    // Power-of-two histogram, safe to fill from several threads.
+    // Bucket 0 counts values below 1, bucket k values in [2^(k-1), 2^k).
+    class Histogram {
+    public:
+        void Add(double value) {
+            size_t bucket = 0;
+            if (value >= 1) {
+                uint64_t integer = value < static_cast<double>(UINT64_MAX) ? static_cast<uint64_t>(value) : UINT64_MAX;
+                while (integer != 0 && bucket + 1 < BUCKET_COUNT) {
+                    integer >>= 1;
+                    ++bucket;
+                }
+            }
+            buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Bucket counts up to the last non-empty bucket
+        std::vector<size_t> GetBuckets() const {
+            std::vector<size_t> result;
+            for (const auto& bucket : buckets_) {
+                result.push_back(bucket.load(std::memory_order_relaxed));
+            }
+            while (!result.empty() && result.back() == 0) {
+                result.pop_back();
+            }
+            return result;
+        }
+
+    private:
+        static constexpr size_t BUCKET_COUNT = 65;
+        std::array<std::atomic<size_t>, BUCKET_COUNT> buckets_{};
+    };
+
+}
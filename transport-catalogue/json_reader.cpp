@@ -2,13 +2,12 @@
 #include "json_builder.h"
 
 
-#include <set>
 #include <sstream>
 #include <map>
 
 using namespace std::literals;
 
-void JsonReader::Read(std::istream& input) {
+void JsonReader::Read(std::istream& input, TransportCatalogue& catalogue) {
     const auto document = json::Load(input);
     const auto& commands = document.GetRoot().AsDict();
 
@@ -19,7 +18,7 @@ void JsonReader::Read(std::istream& input) {
     const auto& routing_settings = commands.find("routing_settings"s);
 
     if (coms_to_add != commands.end()) {
-        ParseCommandsToCatalogue(coms_to_add->second.AsArray());
+        ParseCommandsToCatalogue(coms_to_add->second.AsArray(), catalogue);
     }
 
     if (render_settings != commands.end()) {
@@ -36,7 +35,7 @@ void JsonReader::Read(std::istream& input) {
 
 }
 
-void JsonReader::ParseCommandsToCatalogue(const json::Array& commands) {
+void JsonReader::ParseCommandsToCatalogue(const json::Array& commands, TransportCatalogue& catalogue) {
 
     for (const auto& com : commands) {
         const json::Dict& dict = com.AsDict();
@@ -44,27 +43,34 @@ void JsonReader::ParseCommandsToCatalogue(const json::Array& commands) {
 
         if (dict.at("type"s).AsString() == "Stop"s) {
             CommandStop result;
-            result.name = dict.at("name"s).AsString();
+            result.name = catalogue.InternName(dict.at("name"s).AsString());
 
             result.coords = geo::Coordinates{ dict.at("latitude"s).AsDouble(), dict.at("longitude"s).AsDouble() };
 
             for (const auto& dist : dict.at("road_distances"s).AsDict()) {
-                result.distances.insert({ dist.first, dist.second.AsInt() });
+                result.distances.insert({ catalogue.InternName(dist.first), dist.second.AsInt() });
             }
-            stop_commands_.push_back(result);
+            stop_commands_.push_back(std::move(result));
 
 
         }
         else if (dict.at("type"s).AsString() == "Bus"s) {
             CommandBus result;
-            result.name = dict.at("name"s).AsString();
+            result.name = catalogue.InternName(dict.at("name"s).AsString());
 
             for (const auto& stop_name : dict.at("stops"s).AsArray()) {
-                result.stop_names.push_back(stop_name.AsString());
+                result.stop_names.push_back(catalogue.InternName(stop_name.AsString()));
             }
 
             result.is_roundtrip = dict.at("is_roundtrip"s).AsBool();
-            bus_commands_.push_back(result);
+
+            const auto trip_start_times = dict.find("trip_start_times"s);
+            if (trip_start_times != dict.end()) {
+                for (const auto& start_time : trip_start_times->second.AsArray()) {
+                    result.trip_start_times.push_back(start_time.AsDouble());
+                }
+            }
+            bus_commands_.push_back(std::move(result));
         }
     }
 }
@@ -114,6 +120,39 @@ void JsonReader::ParseCommandsToPrint(const json::Array& com_node) {
             result.type = OutType::ROUTE;
             result.name = dict.at("from").AsString();
             result.to = dict.at("to").AsString();
+
+            const auto departure_time = dict.find("departure_time"s);
+            if (departure_time != dict.end()) {
+                result.departure_time = departure_time->second.AsDouble();
+            }
+
+            const auto debug = dict.find("debug"s);
+            if (debug != dict.end()) {
+                result.debug = debug->second.AsBool();
+            }
+        }
+        else if (dict.at("type"s).AsString() == "Isochrone") {
+            result.type = OutType::ISOCHRONE;
+            result.name = dict.at("from").AsString();
+            result.max_time = dict.at("max_time").AsDouble();
+        }
+        else if (dict.at("type"s).AsString() == "Matrix") {
+            result.type = OutType::MATRIX;
+            for (const auto& source : dict.at("sources"s).AsArray()) {
+                result.sources.push_back(source.AsString());
+            }
+            for (const auto& target : dict.at("targets"s).AsArray()) {
+                result.targets.push_back(target.AsString());
+            }
+        }
+        else if (dict.at("type"s).AsString() == "RouterStats") {
+            result.type = OutType::ROUTER_STATS;
+        }
+        else if (dict.at("type"s).AsString() == "BusDistance") {
+            result.type = OutType::BUS_DISTANCE;
+            result.name = dict.at("name"s).AsString();
+            result.from = dict.at("from"s).AsString();
+            result.to = dict.at("to"s).AsString();
         }
 
         commands_to_out_.push_back(result);
@@ -123,6 +162,77 @@ void JsonReader::ParseCommandsToPrint(const json::Array& com_node) {
 void JsonReader::ParseRoutingSettings(const json::Dict& elem) {
     routing_settings_.bus_velocity = elem.at("bus_velocity"s).AsInt();
     routing_settings_.bus_wait_time = elem.at("bus_wait_time"s).AsInt();
+
+    const auto router_type = elem.find("router_type"s);
+    if (router_type != elem.end()) {
+        if (router_type->second.AsString() == "dijkstra"s) {
+            routing_settings_.router_type = router::RouterType::DIJKSTRA;
+        }
+        else if (router_type->second.AsString() == "contraction_hierarchies"s) {
+            routing_settings_.router_type = router::RouterType::CONTRACTION_HIERARCHIES;
+        }
+        else if (router_type->second.AsString() == "raptor"s) {
+            routing_settings_.router_type = router::RouterType::RAPTOR;
+        }
+        else if (router_type->second.AsString() == "alt"s) {
+            routing_settings_.router_type = router::RouterType::ALT;
+        }
+        else if (router_type->second.AsString() == "partitioned"s) {
+            routing_settings_.router_type = router::RouterType::PARTITIONED;
+        }
+        else if (router_type->second.AsString() == "all_pairs"s) {
+            routing_settings_.router_type = router::RouterType::ALL_PAIRS;
+        }
+        else {
+            throw std::invalid_argument("Unknown router_type"s);
+        }
+    }
+
+    const auto graph_model = elem.find("graph_model"s);
+    if (graph_model != elem.end()) {
+        if (graph_model->second.AsString() == "line"s) {
+            routing_settings_.graph_model = router::GraphModel::LINE;
+        }
+        else if (graph_model->second.AsString() == "compact"s) {
+            routing_settings_.graph_model = router::GraphModel::COMPACT;
+        }
+        else if (graph_model->second.AsString() == "stop_pairs"s) {
+            routing_settings_.graph_model = router::GraphModel::STOP_PAIRS;
+        }
+        else {
+            throw std::invalid_argument("Unknown graph_model"s);
+        }
+    }
+
+    const auto prune_dominated_edges = elem.find("prune_dominated_edges"s);
+    if (prune_dominated_edges != elem.end()) {
+        routing_settings_.prune_dominated_edges = prune_dominated_edges->second.AsBool();
+    }
+
+    const auto route_cache_capacity = elem.find("route_cache_capacity"s);
+    if (route_cache_capacity != elem.end()) {
+        routing_settings_.route_cache_capacity = route_cache_capacity->second.AsInt();
+    }
+
+    const auto landmark_count = elem.find("landmark_count"s);
+    if (landmark_count != elem.end()) {
+        routing_settings_.landmark_count = landmark_count->second.AsInt();
+    }
+
+    const auto partition_cell_size = elem.find("partition_cell_size"s);
+    if (partition_cell_size != elem.end()) {
+        routing_settings_.partition_cell_size = partition_cell_size->second.AsInt();
+    }
+
+    const auto cache_file = elem.find("cache_file"s);
+    if (cache_file != elem.end()) {
+        routing_settings_.cache_file = cache_file->second.AsString();
+    }
+
+    const auto thread_count = elem.find("thread_count"s);
+    if (thread_count != elem.end()) {
+        routing_settings_.thread_count = thread_count->second.AsInt();
+    }
 }
 
 void JsonReader::ApplyCatalogueCommands(TransportCatalogue& catalogue) const {
@@ -133,6 +243,7 @@ void JsonReader::ApplyCatalogueCommands(TransportCatalogue& catalogue) const {
 
     ApplyBusCommands(catalogue);
 
+    catalogue.Finalize(routing_settings_.thread_count);
 }
 
 void JsonReader::ApplyStopCommands(TransportCatalogue& catalogue) const {
@@ -165,7 +276,7 @@ void JsonReader::ApplyBusCommands(TransportCatalogue& catalogue) const {
                 }
             }
         }
-        catalogue.AddBus(bus_com.name, stops, bus_com.is_roundtrip);
+        catalogue.AddBus(bus_com.name, stops, bus_com.is_roundtrip, bus_com.trip_start_times);
     }
 }
 
@@ -173,7 +284,16 @@ void JsonReader::PrintRequests(TransportCatalogue& catalogue, std::ostream& outp
 
     if (!commands_to_out_.empty()) {
 
-        router::TransportRouter router(catalogue, routing_settings_.bus_wait_time, routing_settings_.bus_velocity);
+        router::TransportRouter router(catalogue, routing_settings_);
+
+        std::vector<router::RouteRequest> route_requests;
+        for (const auto& command : commands_to_out_) {
+            if (command.type == OutType::ROUTE && !command.departure_time.has_value() && !command.debug) {
+                route_requests.push_back({ command.name, command.to });
+            }
+        }
+        auto routes = router.ComputeRoutes(route_requests);
+        size_t route_index = 0;
 
         json::Builder builder;
         builder.StartArray();
@@ -186,6 +306,9 @@ void JsonReader::PrintRequests(TransportCatalogue& catalogue, std::ostream& outp
             else if (command.type == OutType::BUS) {
                 builder.Value(std::move(PrintBus(command, catalogue).GetValue()));
             }
+            else if (command.type == OutType::BUS_DISTANCE) {
+                builder.Value(std::move(PrintBusDistance(command, catalogue).GetValue()));
+            }
             else if (command.type == OutType::MAP) {
                 json::Node out_node;
 
@@ -203,9 +326,23 @@ void JsonReader::PrintRequests(TransportCatalogue& catalogue, std::ostream& outp
 
                 builder.Value(std::move(out_node.GetValue()));
             }
+            else if (command.type == OutType::ROUTE && command.debug && !command.departure_time.has_value()) {
+
+                // Answered on its own, so the counters are those of this query alone
+                router::QueryStats stats;
+                const auto result = router.ComputeRoute(command.name, command.to, &stats);
+                if (result.has_value()) {
+                    builder.Value(std::move(BuildRouteNode(command, result.value(), &stats).GetValue()));
+                }
+                else {
+                    builder.Value(std::move(BuildErrorNode(command).GetValue()));
+                }
+            }
             else if (command.type == OutType::ROUTE) {
 
-                const auto result = router.ComputeRoute(command.name, command.to);
+                const auto result = command.departure_time.has_value()
+                    ? router.ComputeRoute(command.name, command.to, command.departure_time.value())
+                    : std::move(routes[route_index++]);
                 if (result.has_value()) {
                     builder.Value(std::move(BuildRouteNode(command, result.value()).GetValue()));
                 }
@@ -213,6 +350,31 @@ void JsonReader::PrintRequests(TransportCatalogue& catalogue, std::ostream& outp
                     builder.Value(std::move(BuildErrorNode(command).GetValue()));
                 }
             }
+            else if (command.type == OutType::MATRIX) {
+
+                const std::vector<std::string_view> sources(command.sources.begin(), command.sources.end());
+                const std::vector<std::string_view> targets(command.targets.begin(), command.targets.end());
+                const auto result = router.ComputeMatrix(sources, targets);
+                if (result.has_value()) {
+                    builder.Value(std::move(BuildMatrixNode(command, result.value()).GetValue()));
+                }
+                else {
+                    builder.Value(std::move(BuildErrorNode(command).GetValue()));
+                }
+            }
+            else if (command.type == OutType::ROUTER_STATS) {
+                builder.Value(std::move(BuildRouterStatsNode(command, router.GetQueryHistograms(), router.GetSearchTotals(), router.GetRouteCacheStats()).GetValue()));
+            }
+            else if (command.type == OutType::ISOCHRONE) {
+
+                const auto result = router.ComputeIsochrone(command.name, command.max_time);
+                if (result.has_value()) {
+                    builder.Value(std::move(BuildIsochroneNode(command, result.value()).GetValue()));
+                }
+                else {
+                    builder.Value(std::move(BuildErrorNode(command).GetValue()));
+                }
+            }
         }
 
 
@@ -228,12 +390,9 @@ json::Node JsonReader::PrintStop(const CommandToOut& com, const TransportCatalog
     auto buses_res = catalogue.FindBusesByStop(com.name);
     if (buses_res.has_value()) {
 
-        std::set<std::string> buses_names;
-        for (const auto& bus : buses_res.value().get()) {
-            buses_names.insert(bus->name);
-        }
-        for (const auto& bus_name : buses_names) {
-            buses.push_back(bus_name);
+        // Already unique and sorted by name
+        for (const BusId bus : buses_res.value()) {
+            buses.push_back(std::string(catalogue.GetBus(bus)->name));
         }
 
         out_node = json::Builder{}
@@ -304,7 +463,7 @@ void JsonReader::ApplyRendererSetting(MapRenderer& renderer) const {
     renderer.SetSettings(commands_to_render_);
 }
 
-json::Node JsonReader::BuildRouteNode(const CommandToOut& com, const std::vector<router::RouteElem>& route_data) const {
+json::Node JsonReader::BuildRouteNode(const CommandToOut& com, const std::vector<router::RouteElem>& route_data, const router::QueryStats* stats) const {
 
     json::Builder j_builder;
 
@@ -327,7 +486,7 @@ json::Node JsonReader::BuildRouteNode(const CommandToOut& com, const std::vector
         }
         else if (elem.type == router::RouteElemType::WAIT) {
             j_builder.Value("Wait");
-            j_builder.Key("stop_name").Value(elem.to->name);
+            j_builder.Key("stop_name").Value(std::string(elem.to->name));
             j_builder.Key("time").Value(elem.time);
         }
         j_builder.EndDict();
@@ -336,17 +495,132 @@ json::Node JsonReader::BuildRouteNode(const CommandToOut& com, const std::vector
     j_builder.EndArray();
     j_builder.Key("request_id").Value(com.id);
     j_builder.Key("total_time").Value(total_time);
+    if (stats != nullptr) {
+        // Settled vertices and the cache hit are counted in every build, the rest only when instrumented
+        j_builder.Key("debug").StartDict()
+            .Key("settled_vertices").Value(static_cast<int>(stats->search.settled_vertices))
+            .Key("cache_hit").Value(stats->cache_hit);
+        if (instrumentation::ENABLED) {
+            j_builder.Key("relaxed_edges").Value(static_cast<int>(stats->search.relaxed_edges))
+                .Key("heap_pushes").Value(static_cast<int>(stats->search.heap_pushes))
+                .Key("heap_pops").Value(static_cast<int>(stats->search.heap_pops))
+                .Key("wall_time_us").Value(stats->wall_time_us);
+        }
+        j_builder.EndDict();
+    }
+    j_builder.EndDict();
+
+
+
+
+    return j_builder.Build();
+}
+
+json::Node JsonReader::BuildMatrixNode(const CommandToOut& com, const router::TravelTimeMatrix& matrix) const {
+
+    json::Builder j_builder;
+
+    j_builder.StartDict()
+        .Key("request_id").Value(com.id)
+        .Key("total_times")
+        .StartArray();
+
+    for (const auto& row : matrix) {
+        j_builder.StartArray();
+        for (const auto& time : row) {
+            if (time.has_value()) {
+                j_builder.Value(time.value());
+            }
+            else {
+                j_builder.Value(nullptr);
+            }
+        }
+        j_builder.EndArray();
+    }
+
+    j_builder.EndArray();
     j_builder.EndDict();
 
+    return j_builder.Build();
+}
+
+json::Node JsonReader::BuildIsochroneNode(const CommandToOut& com, const std::vector<router::IsochroneElem>& isochrone) const {
+
+    json::Builder j_builder;
+
+    j_builder.StartDict()
+        .Key("items")
+        .StartArray();
 
+    for (const auto& elem : isochrone) {
+        j_builder.StartDict()
+            .Key("stop_name").Value(std::string(elem.stop->name))
+            .Key("time").Value(elem.time)
+            .EndDict();
+    }
 
+    j_builder.EndArray();
+    j_builder.Key("request_id").Value(com.id);
+    j_builder.EndDict();
 
     return j_builder.Build();
 }
 
+json::Node JsonReader::PrintBusDistance(const CommandToOut& com, const TransportCatalogue& catalogue) const {
+    const auto distance = catalogue.GetDistanceAlongBus(com.name, com.from, com.to);
+    if (!distance.has_value()) {
+        return BuildErrorNode(com);
+    }
+    return json::Builder{}
+        .StartDict()
+        .Key("distance"s).Value(distance.value())
+        .Key("request_id"s).Value(com.id)
+        .EndDict()
+        .Build();
+}
+
 json::Node JsonReader::BuildErrorNode(const CommandToOut& com) const {
     return json::Builder().StartDict()
         .Key("request_id").Value(com.id)
         .Key("error_message").Value("not found")
         .EndDict().Build();
+}
+
+json::Node JsonReader::BuildRouterStatsNode(const CommandToOut& com, const router::QueryHistograms& histograms, const router::SearchTotals& totals, const cache::CacheStats& cache_stats) const {
+
+    json::Builder j_builder;
+
+    j_builder.StartDict()
+        .Key("request_id").Value(com.id)
+        .Key("query_count").Value(static_cast<int>(histograms.query_count))
+        .Key("route_cache").StartDict()
+            .Key("hits").Value(static_cast<int>(cache_stats.hits))
+            .Key("misses").Value(static_cast<int>(cache_stats.misses))
+        .EndDict()
+        .Key("search_totals").StartDict()
+            .Key("query_count").Value(static_cast<int>(totals.query_count))
+            .Key("settled_vertices").Value(static_cast<int>(totals.settled_vertices))
+        .EndDict()
+        .Key("histograms")
+        .StartDict();
+
+    const std::pair<std::string, const std::vector<size_t>*> metrics[] = {
+        { "settled_vertices"s, &histograms.settled_vertices },
+        { "relaxed_edges"s, &histograms.relaxed_edges },
+        { "heap_pushes"s, &histograms.heap_pushes },
+        { "heap_pops"s, &histograms.heap_pops },
+        { "wall_time_us"s, &histograms.wall_time_us }
+    };
+    for (const auto& [name, buckets] : metrics) {
+        j_builder.Key(name).StartArray();
+        for (const size_t count : *buckets) {
+            j_builder.Value(static_cast<int>(count));
+        }
+        j_builder.EndArray();
+    }
+
+    j_builder.EndDict();
+    j_builder.EndDict();
+
+    return j_builder.Build();
 }
\ No newline at end of file
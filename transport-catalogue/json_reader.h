@@ -2,6 +2,7 @@
 
 #include <map>
 #include <memory>
+#include <optional>
 
 #include "transport_catalogue.h"
 #include "json.h"
@@ -15,16 +16,18 @@ using namespace catalogue;
 
 
 
+// Names of the catalogue commands are views into the name arena of the catalogue they are read for
 struct CommandBus {
-    std::string name;
-    std::vector<std::string> stop_names;
+    std::string_view name;
+    std::vector<std::string_view> stop_names;
     bool is_roundtrip;
+    std::vector<double> trip_start_times;
 };
 
 struct CommandStop {
-    std::string name;
+    std::string_view name;
     geo::Coordinates coords;
-    std::unordered_map<std::string, int> distances;
+    std::unordered_map<std::string_view, int> distances;
 
 };
 
@@ -33,12 +36,11 @@ enum OutType
     BUS,
     STOP,
     MAP,
-    ROUTE
-};
-
-struct RoutingSettings {
-    int bus_wait_time;
-    int bus_velocity;
+    ROUTE,
+    ISOCHRONE,
+    MATRIX,
+    ROUTER_STATS,
+    BUS_DISTANCE
 };
 
 struct RoutingRequest {
@@ -51,24 +53,37 @@ struct CommandToOut {
     int id;
     OutType type;
     std::string name;
+    // BusDistance: stops `from` and `to` on bus `name`; Route uses `name` and `to`
+    std::string from;
     std::string to;
+    std::optional<double> departure_time;
+    // Route: add the query counters to the response (instrumented builds only)
+    bool debug = false;
+    double max_time = 0;
+    std::vector<std::string> sources;
+    std::vector<std::string> targets;
 };
 
 class JsonReader {
 public:
-    void Read(std::istream& input);
+    // Names of the base requests are stored in the catalogue, which must outlive the reader
+    void Read(std::istream& input, TransportCatalogue& catalogue);
     void ApplyCatalogueCommands(TransportCatalogue& catalogue) const;
     void ApplyRendererSetting(MapRenderer& renderer) const;
     void PrintRequests(TransportCatalogue& catalogue, std::ostream& output);
 private:
     json::Node PrintStop(const CommandToOut& com, const TransportCatalogue& catalogue) const;
     json::Node PrintBus(const CommandToOut& com, const TransportCatalogue& catalogue) const;
+    json::Node PrintBusDistance(const CommandToOut& com, const TransportCatalogue& catalogue) const;
 
-    json::Node BuildRouteNode(const CommandToOut& com, const std::vector<router::RouteElem>& route_data) const;
+    json::Node BuildRouteNode(const CommandToOut& com, const std::vector<router::RouteElem>& route_data, const router::QueryStats* stats = nullptr) const;
+    json::Node BuildMatrixNode(const CommandToOut& com, const router::TravelTimeMatrix& matrix) const;
+    json::Node BuildIsochroneNode(const CommandToOut& com, const std::vector<router::IsochroneElem>& isochrone) const;
+    json::Node BuildRouterStatsNode(const CommandToOut& com, const router::QueryHistograms& histograms, const router::SearchTotals& totals, const cache::CacheStats& cache_stats) const;
 
     void ApplyStopCommands(TransportCatalogue& catalogue) const;
     void ApplyBusCommands(TransportCatalogue& catalogue) const;
-    void ParseCommandsToCatalogue(const json::Array& elem);
+    void ParseCommandsToCatalogue(const json::Array& elem, TransportCatalogue& catalogue);
     void ParseRenderSettings(const json::Dict& elem);
     void ParseCommandsToPrint(const json::Array& com_node);
     void ParseRoutingSettings(const json::Dict& elem);
@@ -85,6 +100,6 @@ private:
     std::vector<CommandToOut> commands_to_out_;
 
     std::vector<RoutingRequest> routing_requests_;
-    RoutingSettings routing_settings_;
+    router::RoutingSettings routing_settings_;
 };
 
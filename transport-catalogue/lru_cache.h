@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cache {
+
+    struct CacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    // Bounded least-recently-used cache, safe to share between threads.
+    // Keys are spread over independent shards by hash, each with its own lock and LRU list,
+    // so concurrent lookups of different keys rarely contend. Capacity is split evenly
+    // between shards; a capacity of 0 disables the cache.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class ShardedLruCache {
+    public:
+        explicit ShardedLruCache(size_t capacity, size_t shard_count = 16)
+            : shards_(std::max<size_t>(1, std::min(shard_count, capacity)))
+            , shard_capacity_((capacity + shards_.size() - 1) / shards_.size())
+        {
+        }
+
+        // Copy of the cached value, which becomes the most recently used
+        std::optional<Value> Get(const Key& key) {
+            if (shard_capacity_ == 0) {
+                return std::nullopt;
+            }
+            Shard& shard = GetShard(key);
+            std::lock_guard guard(shard.mutex);
+            const auto it = shard.index.find(key);
+            if (it == shard.index.end()) {
+                misses_.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            return it->second->second;
+        }
+
+        // Inserts or replaces the value; the least recently used entry of the shard is evicted when full
+        void Put(const Key& key, Value value) {
+            if (shard_capacity_ == 0) {
+                return;
+            }
+            Shard& shard = GetShard(key);
+            std::lock_guard guard(shard.mutex);
+            const auto it = shard.index.find(key);
+            if (it != shard.index.end()) {
+                it->second->second = std::move(value);
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                return;
+            }
+            if (shard.entries.size() == shard_capacity_) {
+                shard.index.erase(shard.entries.back().first);
+                shard.entries.pop_back();
+            }
+            shard.entries.emplace_front(key, std::move(value));
+            shard.index.insert({ key, shard.entries.begin() });
+        }
+
+        // Drops every entry; the counters are kept
+        void Clear() {
+            for (auto& shard : shards_) {
+                std::lock_guard guard(shard.mutex);
+                shard.index.clear();
+                shard.entries.clear();
+            }
+        }
+
+        CacheStats GetStats() const {
+            return { hits_.load(), misses_.load() };
+        }
+
+    private:
+        struct Shard {
+            std::mutex mutex;
+            // Most recently used first
+            std::list<std::pair<Key, Value>> entries;
+            std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index;
+        };
+
+        Shard& GetShard(const Key& key) {
+            // Integer hashes are often the identity, and packed keys share low bits:
+            // a multiplicative mix spreads them before the shard is picked from the high bits
+            const uint64_t hash = static_cast<uint64_t>(Hash{}(key)) * 0x9e3779b97f4a7c15ull;
+            return shards_[(hash >> 32) % shards_.size()];
+        }
+
+        std::vector<Shard> shards_;
+        size_t shard_capacity_;
+        std::atomic<size_t> hits_ = 0;
+        std::atomic<size_t> misses_ = 0;
+    };
+
+}
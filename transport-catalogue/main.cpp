@@ -7,10 +7,9 @@ using namespace std;
 
 int main() {
 
-    JsonReader reader;
-    reader.Read(cin);
-
     TransportCatalogue catalogue;
+    JsonReader reader;
+    reader.Read(cin, catalogue);
     reader.ApplyCatalogueCommands(catalogue);
 
     reader.PrintRequests(catalogue, cout);
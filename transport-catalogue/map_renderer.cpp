@@ -8,7 +8,7 @@ void MapRenderer::RenderMap(const catalogue::TransportCatalogue& catalogue, std:
 
     std::vector<const Bus*> buses;
     for (const auto& bus : catalogue.GetBuses()) {
-        if (!bus->stops.empty()) {
+        if (!catalogue.GetBusStopIds(bus->id).empty()) {
             buses.push_back(bus);
         }
     }
@@ -20,35 +20,39 @@ void MapRenderer::RenderMap(const catalogue::TransportCatalogue& catalogue, std:
     auto color_iter = settings_.color_palette.begin();
     svg::Document document;
 
+    const auto stop_coords = catalogue.GetStopCoordinates();
     std::vector<geo::Coordinates> points_to_proj;
     for (const auto& bus_ptr : buses) {
-        for (const auto& stop_ptr : bus_ptr->stops) {
-            points_to_proj.push_back(stop_ptr->coords);
+        for (const StopId stop_id : catalogue.GetBusStopIds(bus_ptr->id)) {
+            points_to_proj.push_back(stop_coords[stop_id]);
         }
     }
     geo::SphereProjector projector(points_to_proj.begin(), points_to_proj.end(), settings_.width, settings_.height, settings_.padding);
 
 
-    RenderLines(buses, color_iter, document, projector);
+    RenderLines(catalogue, buses, color_iter, document, projector);
 
-    RenderNames(buses, color_iter, document, projector);
+    RenderNames(catalogue, buses, color_iter, document, projector);
 
 
     std::map<std::string_view, const Stop*> stops;
     for (const auto& bus : buses) {
-        for (const auto& stop : bus->stops) {
+        for (const StopId stop_id : catalogue.GetBusStopIds(bus->id)) {
+            const Stop* stop = catalogue.GetStop(stop_id);
             stops.insert({ stop->name, stop });
         }
     }
 
-    RenderStopsCircles(stops, document, projector);
+    RenderStopsCircles(catalogue, stops, document, projector);
 
-    RenderStopsNames(stops, document, projector);
+    RenderStopsNames(catalogue, stops, document, projector);
 
     document.Render(out);
 }
 
-void MapRenderer::RenderLines(const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const {
+void MapRenderer::RenderLines(const catalogue::TransportCatalogue& catalogue, const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const {
+
+    const auto stop_coords = catalogue.GetStopCoordinates();
 
     for (const auto& bus : buses) {
         svg::Polyline line;
@@ -58,8 +62,8 @@ void MapRenderer::RenderLines(const std::vector<const Bus*> buses, Color_Iterato
         line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
         line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
 
-        for (const auto stop : bus->stops) {
-            line.AddPoint(proj(stop->coords));
+        for (const StopId stop_id : catalogue.GetBusStopIds(bus->id)) {
+            line.AddPoint(proj(stop_coords[stop_id]));
         }
         doc.Add(line);
 
@@ -71,17 +75,20 @@ void MapRenderer::RenderLines(const std::vector<const Bus*> buses, Color_Iterato
     color_iter = settings_.color_palette.begin();
 }
 
-void MapRenderer::RenderNames(const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const {
+void MapRenderer::RenderNames(const catalogue::TransportCatalogue& catalogue, const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const {
+
+    const auto stop_coords = catalogue.GetStopCoordinates();
 
     for (const auto& bus : buses) {
+        const auto bus_stops = catalogue.GetBusStopIds(bus->id);
 
         svg::Text text_f;
-        text_f.SetPosition(proj(bus->stops.at(0)->coords));
+        text_f.SetPosition(proj(stop_coords[bus_stops.front()]));
         text_f.SetOffset(settings_.bus_label_offset);
         text_f.SetFontSize(settings_.bus_label_font_size);
         text_f.SetFontFamily("Verdana");
         text_f.SetFontWeight("bold");
-        text_f.SetData(bus->name);
+        text_f.SetData(std::string(bus->name));
         text_f.SetFillColor(*color_iter);
 
         svg::Text text_f_h = text_f;
@@ -94,10 +101,10 @@ void MapRenderer::RenderNames(const std::vector<const Bus*> buses, Color_Iterato
         doc.Add(text_f_h);
         doc.Add(text_f);
 
-        if (!bus->is_roundtrip && (bus->stops.front()) != (bus->stops.at(bus->stops.size() / 2))) {
+        if (!bus->is_roundtrip && bus_stops.front() != bus_stops[bus_stops.size() / 2]) {
             svg::Text text_l = text_f;
             svg::Text text_l_h = text_f_h;
-            svg::Point coords = proj(bus->stops.at(bus->stops.size() / 2)->coords);
+            svg::Point coords = proj(stop_coords[bus_stops[bus_stops.size() / 2]]);
             text_l.SetPosition(coords);
             text_l_h.SetPosition(coords);
 
@@ -113,20 +120,22 @@ void MapRenderer::RenderNames(const std::vector<const Bus*> buses, Color_Iterato
     color_iter = settings_.color_palette.begin();
 }
 
-void MapRenderer::RenderStopsCircles(const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const {
+void MapRenderer::RenderStopsCircles(const catalogue::TransportCatalogue& catalogue, const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const {
+    const auto stop_coords = catalogue.GetStopCoordinates();
     for (const auto& stop : stops) {
-        doc.Add(svg::Circle().SetCenter(proj(stop.second->coords)).SetRadius(settings_.stop_radius).SetFillColor("white"));
+        doc.Add(svg::Circle().SetCenter(proj(stop_coords[stop.second->id])).SetRadius(settings_.stop_radius).SetFillColor("white"));
     }
 }
 
-void MapRenderer::RenderStopsNames(const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const {
+void MapRenderer::RenderStopsNames(const catalogue::TransportCatalogue& catalogue, const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const {
+    const auto stop_coords = catalogue.GetStopCoordinates();
     for (const auto& stop : stops) {
         svg::Text name;
-        name.SetPosition(proj(stop.second->coords));
+        name.SetPosition(proj(stop_coords[stop.second->id]));
         name.SetOffset(settings_.stop_label_offset);
         name.SetFontSize(settings_.stop_label_font_size);
         name.SetFontFamily("Verdana");
-        name.SetData(stop.second->name);
+        name.SetData(std::string(stop.second->name));
         name.SetFillColor("black");
 
         svg::Text hedge = name;
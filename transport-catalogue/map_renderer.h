@@ -35,10 +35,10 @@ public:
     void SetSettings(const RenderSettings& settings);
     void RenderMap(const catalogue::TransportCatalogue& catalogue, std::ostream& out) const;
 private:
-    void RenderLines(const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const;
-    void RenderNames(const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const;
-    void RenderStopsCircles(const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const;
-    void RenderStopsNames(const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const;
+    void RenderLines(const catalogue::TransportCatalogue& catalogue, const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const;
+    void RenderNames(const catalogue::TransportCatalogue& catalogue, const std::vector<const Bus*> buses, Color_Iterator color_iter, svg::Document& doc, geo::SphereProjector& proj) const;
+    void RenderStopsCircles(const catalogue::TransportCatalogue& catalogue, const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const;
+    void RenderStopsNames(const catalogue::TransportCatalogue& catalogue, const std::map<std::string_view, const Stop*>& stops, svg::Document& doc, geo::SphereProjector& proj) const;
 
     RenderSettings settings_;
 };
\ No newline at end of file
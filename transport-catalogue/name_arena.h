@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace catalogue {
+
+    // Append-only store of interned names. Every distinct name is copied once into large blocks
+    // that are never reallocated, so the views handed out stay valid for the lifetime of the
+    // arena, also after it is moved. Equal names get the same view.
+    class NameArena {
+    public:
+        explicit NameArena(size_t block_size = 64 * 1024)
+            : block_size_(block_size)
+        {
+        }
+
+        std::string_view Intern(std::string_view name) {
+            const auto it = names_.find(name);
+            if (it != names_.end()) {
+                return *it;
+            }
+            const std::string_view stored = Store(name);
+            names_.insert(stored);
+            return stored;
+        }
+
+        size_t GetNameCount() const {
+            return names_.size();
+        }
+
+        // Characters stored, one copy per distinct name
+        size_t GetByteCount() const {
+            return byte_count_;
+        }
+
+    private:
+        std::string_view Store(std::string_view name) {
+            if (name.empty()) {
+                return {};
+            }
+
+            // Long names get a block of their own, behind the current one, so it is not wasted
+            if (name.size() > block_size_ / 4) {
+                auto block = std::make_unique<char[]>(name.size());
+                std::memcpy(block.get(), name.data(), name.size());
+                const std::string_view stored(block.get(), name.size());
+                if (blocks_.empty()) {
+                    blocks_.push_back(std::move(block));
+                    block_used_ = block_size_;
+                }
+                else {
+                    blocks_.insert(std::prev(blocks_.end()), std::move(block));
+                }
+                byte_count_ += name.size();
+                return stored;
+            }
+
+            if (blocks_.empty() || block_used_ + name.size() > block_size_) {
+                blocks_.push_back(std::make_unique<char[]>(block_size_));
+                block_used_ = 0;
+            }
+            char* destination = blocks_.back().get() + block_used_;
+            std::memcpy(destination, name.data(), name.size());
+            block_used_ += name.size();
+            byte_count_ += name.size();
+            return { destination, name.size() };
+        }
+
+        size_t block_size_;
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        size_t block_used_ = 0;
+        size_t byte_count_ = 0;
+        std::unordered_set<std::string_view> names_;
+    };
+
+}
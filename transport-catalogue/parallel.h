@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+    // 0 means "use every hardware thread"
+    inline size_t ResolveThreadCount(int thread_count) {
+        if (thread_count > 0) {
+            return static_cast<size_t>(thread_count);
+        }
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Reusable barrier: every Wait() returns once thread_count threads have called it
+    class Barrier {
+    public:
+        explicit Barrier(size_t thread_count)
+            : thread_count_(thread_count)
+        {
+        }
+
+        void Wait() {
+            std::unique_lock lock(mutex_);
+            const size_t generation = generation_;
+            if (++waiting_ == thread_count_) {
+                waiting_ = 0;
+                ++generation_;
+                condition_.notify_all();
+                return;
+            }
+            condition_.wait(lock, [&]() {
+                return generation != generation_;
+            });
+        }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        size_t thread_count_;
+        size_t waiting_ = 0;
+        size_t generation_ = 0;
+    };
+
+    // Calls func(thread_index) once on each of thread_count threads, the calling thread included.
+    // The first exception thrown by func is rethrown in the calling thread.
+    template <typename Func>
+    void ForEachThread(size_t thread_count, Func func) {
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto work = [&](size_t thread_index) {
+            try {
+                func(thread_index);
+            }
+            catch (...) {
+                std::lock_guard guard(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count > 0 ? thread_count - 1 : 0);
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads.emplace_back(work, i);
+        }
+        work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Calls func(index) for every index in [0, count) on up to thread_count threads.
+    // Indices are handed out in small blocks, so uneven work still balances across threads.
+    // The first exception thrown by func is rethrown in the calling thread.
+    template <typename Func>
+    void ForEachIndex(size_t count, size_t thread_count, Func func) {
+        const size_t workers = std::min(std::max<size_t>(thread_count, 1), count);
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        const size_t block = std::max<size_t>(1, count / (workers * 8));
+        std::atomic<size_t> next = 0;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto work = [&]() {
+            try {
+                for (size_t begin = next.fetch_add(block); begin < count; begin = next.fetch_add(block)) {
+                    const size_t end = std::min(count, begin + block);
+                    for (size_t i = begin; i < end; ++i) {
+                        func(i);
+                    }
+                }
+            }
+            catch (...) {
+                std::lock_guard guard(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (size_t i = 1; i < workers; ++i) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+}
@@ -0,0 +1,476 @@
+#pragma once
+
+#include "graph.h"
+#include "csr_graph.h"
+#include "dijkstra_router.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Outgoing edge of a cell vertex; `to` may lie in another cell (a cut edge)
+    template <typename Weight>
+    struct CellEdge {
+        VertexId to;
+        EdgeId edge_id;
+        Weight weight;
+    };
+
+    // Everything the local searches of one cell need. Self-contained, so a cell can be
+    // saved and loaded on its own.
+    template <typename Weight>
+    struct GraphCell {
+        // Local index -> graph vertex, ascending
+        std::vector<VertexId> vertices;
+        // Edges of local vertex i are edges[offsets[i]..offsets[i + 1]]
+        std::vector<size_t> offsets;
+        std::vector<CellEdge<Weight>> edges;
+    };
+
+    // The partition and the overlay graph over the cell boundaries, kept in memory whole.
+    // An entry vertex has an edge from another cell, an exit vertex an edge to another cell.
+    // The clique of a cell holds the shortest distance inside the cell from each of its entries
+    // to each of its exits.
+    template <typename Weight>
+    struct PartitionOverlay {
+        std::vector<uint32_t> cell_by_vertex;
+        // Index of the vertex in GraphCell::vertices of its cell
+        std::vector<uint32_t> local_by_vertex;
+        // Entries of cell c are entry_vertices[entry_offsets[c]..entry_offsets[c + 1]], exits alike
+        std::vector<size_t> entry_offsets;
+        std::vector<VertexId> entry_vertices;
+        std::vector<size_t> exit_offsets;
+        std::vector<VertexId> exit_vertices;
+        // Clique of cell c: entry count * exit count weights from clique_offsets[c], a row per entry
+        std::vector<size_t> clique_offsets;
+        std::vector<Weight> clique_weights;
+        // Cut edges leaving exit i are cut_edges[cut_offsets[i]..cut_offsets[i + 1]]
+        std::vector<size_t> cut_offsets;
+        std::vector<CellEdge<Weight>> cut_edges;
+    };
+
+    // One-level multilevel-Dijkstra router over a partition of the graph into cells.
+    // A query runs Dijkstra over the original edges of the source and target cells only;
+    // any other cell is entered over a cut edge, crossed in one step along its clique and
+    // left over a cut edge again.
+    // Clique hops of the result are unpacked by a search inside their cell.
+    // Built from a graph every cell is in memory. Built from a saved overlay, cells are fetched
+    // through the loader on first use: the source and target cells of a query and every cell
+    // a clique hop of its result crosses. This defers loading, it does not bound memory;
+    // long routes touch most cells.
+    // Graph is DirectedWeightedGraph or its frozen CsrGraph copy.
+    template <typename Weight, typename Graph = DirectedWeightedGraph<Weight>>
+    class PartitionedRouter {
+    public:
+        using Cell = GraphCell<Weight>;
+        using Overlay = PartitionOverlay<Weight>;
+        using CellLoader = std::function<Cell(size_t cell)>;
+
+        // cell_by_vertex numbers the cells from 0 without gaps
+        PartitionedRouter(const Graph& graph, std::vector<uint32_t> cell_by_vertex, size_t thread_count);
+        PartitionedRouter(Overlay overlay, CellLoader loader);
+
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+        // Rebuilds cells and cliques for new weights of the same graph; the partition is kept
+        void Customize(const Graph& graph, size_t thread_count);
+
+        const Overlay& GetOverlay() const {
+            return overlay_;
+        }
+
+        size_t GetCellCount() const {
+            return overlay_.entry_offsets.size() - 1;
+        }
+
+        // Loads the cell if this is its first use
+        std::shared_ptr<const Cell> GetCell(size_t cell) const;
+
+        // The cell made of `vertices` (ascending); a loader can fall back to it
+        static Cell MakeCell(const Graph& graph, const std::vector<VertexId>& vertices);
+
+    private:
+        struct VertexState {
+            Weight weight;
+            VertexId prev_vertex;
+            // NO_EDGE when the vertex was reached along a clique
+            EdgeId prev_edge;
+            uint32_t stamp = 0;
+            bool settled = false;
+        };
+
+        struct SearchSpace {
+            std::vector<VertexState> states;
+            uint32_t stamp = 0;
+
+            void Reset(size_t vertex_count) {
+                if (states.size() < vertex_count) {
+                    states.resize(vertex_count);
+                }
+                if (++stamp == 0) {
+                    for (auto& state : states) {
+                        state.stamp = 0;
+                    }
+                    stamp = 1;
+                }
+            }
+        };
+
+        using QueueElem = std::pair<Weight, VertexId>;
+        using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<QueueElem>>;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::max();
+        static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+        static constexpr size_t NO_INDEX = static_cast<size_t>(-1);
+
+        void Build(const Graph& graph, size_t thread_count);
+        void IndexBoundary();
+        std::vector<size_t> IndexVertices(const std::vector<VertexId>& vertices) const;
+        // Dijkstra from local vertex `from` over the edges inside the cell; stops once `to` is
+        // settled unless `to` is NO_INDEX. Local vertex indices are used as search vertices.
+        void SearchCell(SearchSpace& space, const Cell& cell, uint32_t cell_id, size_t from, size_t to) const;
+        void UnpackClique(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+
+        Overlay overlay_;
+        // Indices into overlay_.entry_vertices and overlay_.exit_vertices, NO_INDEX if the vertex is not one
+        std::vector<size_t> entry_index_by_vertex_;
+        std::vector<size_t> exit_index_by_vertex_;
+
+        CellLoader loader_;
+        mutable std::mutex cells_mutex_;
+        mutable std::vector<std::shared_ptr<const Cell>> cells_;
+    };
+
+    template <typename Weight, typename Graph>
+    PartitionedRouter<Weight, Graph>::PartitionedRouter(const Graph& graph, std::vector<uint32_t> cell_by_vertex, size_t thread_count) {
+        if (cell_by_vertex.size() != graph.GetVertexCount()) {
+            throw std::invalid_argument("Partition should assign a cell to every vertex");
+        }
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+        overlay_.cell_by_vertex = std::move(cell_by_vertex);
+        Build(graph, thread_count);
+    }
+
+    template <typename Weight, typename Graph>
+    PartitionedRouter<Weight, Graph>::PartitionedRouter(Overlay overlay, CellLoader loader)
+        : overlay_(std::move(overlay))
+        , loader_(std::move(loader))
+    {
+        IndexBoundary();
+        cells_.resize(GetCellCount());
+    }
+
+    template <typename Weight, typename Graph>
+    void PartitionedRouter<Weight, Graph>::Customize(const Graph& graph, size_t thread_count) {
+        if (graph.GetVertexCount() != overlay_.cell_by_vertex.size()) {
+            throw std::invalid_argument("Customization needs the graph the partition was built for");
+        }
+        Build(graph, thread_count);
+    }
+
+    template <typename Weight, typename Graph>
+    typename PartitionedRouter<Weight, Graph>::Cell PartitionedRouter<Weight, Graph>::MakeCell(const Graph& graph, const std::vector<VertexId>& vertices) {
+        Cell cell;
+        cell.vertices = vertices;
+        cell.offsets.reserve(vertices.size() + 1);
+        cell.offsets.push_back(0);
+        for (const VertexId vertex : vertices) {
+            ForEachOutgoingEdge(graph, vertex, [&](EdgeId edge_id, VertexId to, Weight weight) {
+                cell.edges.push_back({ to, edge_id, weight });
+            });
+            cell.offsets.push_back(cell.edges.size());
+        }
+        return cell;
+    }
+
+    template <typename Weight, typename Graph>
+    void PartitionedRouter<Weight, Graph>::Build(const Graph& graph, size_t thread_count) {
+        const size_t vertex_count = graph.GetVertexCount();
+        const auto& cell_by_vertex = overlay_.cell_by_vertex;
+        const size_t cell_count = vertex_count == 0 ? 0 : *std::max_element(cell_by_vertex.begin(), cell_by_vertex.end()) + 1;
+
+        std::vector<std::vector<VertexId>> vertices_by_cell(cell_count);
+        overlay_.local_by_vertex.assign(vertex_count, 0);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            auto& vertices = vertices_by_cell[cell_by_vertex[vertex]];
+            overlay_.local_by_vertex[vertex] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vertex);
+        }
+
+        std::vector<char> is_entry(vertex_count, 0);
+        std::vector<char> is_exit(vertex_count, 0);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            ForEachOutgoingEdge(graph, vertex, [&](EdgeId, VertexId to, Weight) {
+                if (cell_by_vertex[to] != cell_by_vertex[vertex]) {
+                    is_exit[vertex] = 1;
+                    is_entry[to] = 1;
+                }
+            });
+        }
+
+        overlay_.entry_offsets.assign(1, 0);
+        overlay_.entry_vertices.clear();
+        overlay_.exit_offsets.assign(1, 0);
+        overlay_.exit_vertices.clear();
+        overlay_.clique_offsets.assign(1, 0);
+        for (const auto& vertices : vertices_by_cell) {
+            for (const VertexId vertex : vertices) {
+                if (is_entry[vertex]) {
+                    overlay_.entry_vertices.push_back(vertex);
+                }
+                if (is_exit[vertex]) {
+                    overlay_.exit_vertices.push_back(vertex);
+                }
+            }
+            const size_t entry_count = overlay_.entry_vertices.size() - overlay_.entry_offsets.back();
+            const size_t exit_count = overlay_.exit_vertices.size() - overlay_.exit_offsets.back();
+            overlay_.entry_offsets.push_back(overlay_.entry_vertices.size());
+            overlay_.exit_offsets.push_back(overlay_.exit_vertices.size());
+            overlay_.clique_offsets.push_back(overlay_.clique_offsets.back() + entry_count * exit_count);
+        }
+
+        overlay_.cut_offsets.assign(1, 0);
+        overlay_.cut_edges.clear();
+        for (const VertexId vertex : overlay_.exit_vertices) {
+            ForEachOutgoingEdge(graph, vertex, [&](EdgeId edge_id, VertexId to, Weight weight) {
+                if (cell_by_vertex[to] != cell_by_vertex[vertex]) {
+                    overlay_.cut_edges.push_back({ to, edge_id, weight });
+                }
+            });
+            overlay_.cut_offsets.push_back(overlay_.cut_edges.size());
+        }
+        IndexBoundary();
+
+        // Cells are independent: each builds its edges and clique on its own thread
+        cells_.assign(cell_count, nullptr);
+        overlay_.clique_weights.assign(overlay_.clique_offsets.back(), UNREACHABLE);
+        parallel::ForEachIndex(cell_count, thread_count, [&](size_t cell_id) {
+            auto cell = std::make_shared<Cell>(MakeCell(graph, vertices_by_cell[cell_id]));
+
+            thread_local SearchSpace space;
+            const size_t entry_begin = overlay_.entry_offsets[cell_id];
+            const size_t entry_count = overlay_.entry_offsets[cell_id + 1] - entry_begin;
+            const size_t exit_begin = overlay_.exit_offsets[cell_id];
+            const size_t exit_count = overlay_.exit_offsets[cell_id + 1] - exit_begin;
+            Weight* clique = overlay_.clique_weights.data() + overlay_.clique_offsets[cell_id];
+            for (size_t i = 0; i < entry_count; ++i) {
+                SearchCell(space, *cell, static_cast<uint32_t>(cell_id), overlay_.local_by_vertex[overlay_.entry_vertices[entry_begin + i]], NO_INDEX);
+                for (size_t j = 0; j < exit_count; ++j) {
+                    const auto& state = space.states[overlay_.local_by_vertex[overlay_.exit_vertices[exit_begin + j]]];
+                    if (state.stamp == space.stamp) {
+                        clique[i * exit_count + j] = state.weight;
+                    }
+                }
+            }
+            cells_[cell_id] = std::move(cell);
+        });
+    }
+
+    template <typename Weight, typename Graph>
+    void PartitionedRouter<Weight, Graph>::IndexBoundary() {
+        entry_index_by_vertex_ = IndexVertices(overlay_.entry_vertices);
+        exit_index_by_vertex_ = IndexVertices(overlay_.exit_vertices);
+    }
+
+    template <typename Weight, typename Graph>
+    std::vector<size_t> PartitionedRouter<Weight, Graph>::IndexVertices(const std::vector<VertexId>& vertices) const {
+        std::vector<size_t> index_by_vertex(overlay_.cell_by_vertex.size(), NO_INDEX);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            index_by_vertex[vertices[i]] = i;
+        }
+        return index_by_vertex;
+    }
+
+    template <typename Weight, typename Graph>
+    std::shared_ptr<const typename PartitionedRouter<Weight, Graph>::Cell> PartitionedRouter<Weight, Graph>::GetCell(size_t cell) const {
+        std::lock_guard guard(cells_mutex_);
+        auto& result = cells_.at(cell);
+        if (!result) {
+            result = std::make_shared<Cell>(loader_(cell));
+        }
+        return result;
+    }
+
+    template <typename Weight, typename Graph>
+    void PartitionedRouter<Weight, Graph>::SearchCell(SearchSpace& space, const Cell& cell, uint32_t cell_id, size_t from, size_t to) const {
+        space.Reset(cell.vertices.size());
+        auto& states = space.states;
+        const uint32_t stamp = space.stamp;
+
+        Queue queue;
+        states[from] = { ZERO_WEIGHT, from, NO_EDGE, stamp, false };
+        queue.push({ ZERO_WEIGHT, from });
+
+        while (!queue.empty()) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            auto& state = states[vertex];
+            if (state.settled || state.weight < weight) {
+                continue;
+            }
+            state.settled = true;
+            if (vertex == to) {
+                return;
+            }
+
+            for (size_t i = cell.offsets[vertex]; i < cell.offsets[vertex + 1]; ++i) {
+                const auto& edge = cell.edges[i];
+                if (overlay_.cell_by_vertex[edge.to] != cell_id) {
+                    continue;
+                }
+                const size_t next_vertex = overlay_.local_by_vertex[edge.to];
+                auto& next = states[next_vertex];
+                const Weight candidate = weight + edge.weight;
+                if (next.stamp != stamp) {
+                    next = { candidate, vertex, edge.edge_id, stamp, false };
+                    queue.push({ candidate, next_vertex });
+                }
+                else if (!next.settled && candidate < next.weight) {
+                    next.weight = candidate;
+                    next.prev_vertex = vertex;
+                    next.prev_edge = edge.edge_id;
+                    queue.push({ candidate, next_vertex });
+                }
+            }
+        }
+    }
+
+    // Appends the edges of the clique hop in reverse order, as the route extraction walks back
+    template <typename Weight, typename Graph>
+    void PartitionedRouter<Weight, Graph>::UnpackClique(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+        thread_local SearchSpace space;
+        const uint32_t cell_id = overlay_.cell_by_vertex[from];
+        const auto cell = GetCell(cell_id);
+        const size_t local_from = overlay_.local_by_vertex[from];
+        SearchCell(space, *cell, cell_id, local_from, overlay_.local_by_vertex[to]);
+        for (size_t vertex = overlay_.local_by_vertex[to]; vertex != local_from; vertex = space.states[vertex].prev_vertex) {
+            edges.push_back(space.states[vertex].prev_edge);
+        }
+    }
+
+    template <typename Weight, typename Graph>
+    std::optional<typename PartitionedRouter<Weight, Graph>::RouteInfo> PartitionedRouter<Weight, Graph>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+        thread_local SearchSpace space;
+        space.Reset(overlay_.cell_by_vertex.size());
+        auto& states = space.states;
+        const uint32_t stamp = space.stamp;
+
+        const uint32_t source_cell_id = overlay_.cell_by_vertex.at(from);
+        const uint32_t target_cell_id = overlay_.cell_by_vertex.at(to);
+        const auto source_cell = GetCell(source_cell_id);
+        const auto target_cell = GetCell(target_cell_id);
+
+        Queue queue;
+        states[from] = { ZERO_WEIGHT, from, NO_EDGE, stamp, false };
+        queue.push({ ZERO_WEIGHT, from });
+
+        SearchStats search_stats;
+        ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+        const auto relax = [&](VertexId vertex, Weight candidate, VertexId prev_vertex, EdgeId prev_edge) {
+            ROUTER_INSTRUMENT(++search_stats.relaxed_edges;)
+            auto& state = states[vertex];
+            if (state.stamp != stamp) {
+                state = { candidate, prev_vertex, prev_edge, stamp, false };
+                queue.push({ candidate, vertex });
+                ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+            }
+            else if (!state.settled && candidate < state.weight) {
+                state.weight = candidate;
+                state.prev_vertex = prev_vertex;
+                state.prev_edge = prev_edge;
+                queue.push({ candidate, vertex });
+                ROUTER_INSTRUMENT(++search_stats.heap_pushes;)
+            }
+        };
+
+        while (!queue.empty()) {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+            ROUTER_INSTRUMENT(++search_stats.heap_pops;)
+            auto& state = states[vertex];
+            if (state.settled || state.weight < weight) {
+                continue;
+            }
+            state.settled = true;
+            ++search_stats.settled_vertices;
+            if (vertex == to) {
+                break;
+            }
+
+            const uint32_t cell_id = overlay_.cell_by_vertex[vertex];
+            if (cell_id == source_cell_id || cell_id == target_cell_id) {
+                const Cell& cell = cell_id == source_cell_id ? *source_cell : *target_cell;
+                const size_t local = overlay_.local_by_vertex[vertex];
+                for (size_t i = cell.offsets[local]; i < cell.offsets[local + 1]; ++i) {
+                    const auto& edge = cell.edges[i];
+                    relax(edge.to, weight + edge.weight, vertex, edge.edge_id);
+                }
+                continue;
+            }
+
+            // Any other cell is reached at its entries and crossed to its exits
+            const size_t entry_index = entry_index_by_vertex_[vertex];
+            if (entry_index != NO_INDEX) {
+                const size_t exit_begin = overlay_.exit_offsets[cell_id];
+                const size_t exit_count = overlay_.exit_offsets[cell_id + 1] - exit_begin;
+                const Weight* clique = overlay_.clique_weights.data() + overlay_.clique_offsets[cell_id] + (entry_index - overlay_.entry_offsets[cell_id]) * exit_count;
+                for (size_t j = 0; j < exit_count; ++j) {
+                    const VertexId exit = overlay_.exit_vertices[exit_begin + j];
+                    if (clique[j] != UNREACHABLE && exit != vertex) {
+                        relax(exit, weight + clique[j], vertex, NO_EDGE);
+                    }
+                }
+            }
+            const size_t exit_index = exit_index_by_vertex_[vertex];
+            if (exit_index != NO_INDEX) {
+                for (size_t i = overlay_.cut_offsets[exit_index]; i < overlay_.cut_offsets[exit_index + 1]; ++i) {
+                    const auto& edge = overlay_.cut_edges[i];
+                    relax(edge.to, weight + edge.weight, vertex, edge.edge_id);
+                }
+            }
+        }
+
+        if (stats != nullptr) {
+            *stats = search_stats;
+        }
+        if (states[to].stamp != stamp || !states[to].settled) {
+            return std::nullopt;
+        }
+
+        RouteInfo route{ states[to].weight, {} };
+        for (VertexId vertex = to; vertex != from; vertex = states[vertex].prev_vertex) {
+            const auto& state = states[vertex];
+            if (state.prev_edge == NO_EDGE) {
+                UnpackClique(state.prev_vertex, vertex, route.edges);
+            }
+            else {
+                route.edges.push_back(state.prev_edge);
+            }
+        }
+        std::reverse(route.edges.begin(), route.edges.end());
+        return route;
+    }
+
+}
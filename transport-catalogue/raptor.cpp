@@ -0,0 +1,238 @@
+#include "raptor.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace router {
+
+    namespace {
+
+        const double UNREACHED = std::numeric_limits<double>::infinity();
+
+    }
+
+    // Per-thread scratch space. Labels and parents are kept for every round, round-major,
+    // so a journey can be walked back ride by ride.
+    struct Raptor::SearchSpace {
+        size_t stop_count = 0;
+        size_t round_count = 0;
+        std::vector<double> labels;
+        std::vector<Parent> parents;
+        std::vector<double> best;
+
+        std::vector<StopId> marked;
+        std::vector<char> is_marked;
+        std::vector<uint32_t> route_start;
+        std::vector<RouteId> queued_routes;
+
+        void Reset(size_t stops, size_t routes) {
+            stop_count = stops;
+            round_count = 1;
+            labels.assign(stops, UNREACHED);
+            parents.assign(stops, { 0, NO_POSITION, NO_POSITION, 0 });
+            best.assign(stops, UNREACHED);
+            marked.clear();
+            is_marked.assign(stops, 0);
+            route_start.assign(routes, NO_POSITION);
+            queued_routes.clear();
+        }
+
+        // The new round starts as a copy of the previous one
+        void AddRound() {
+            labels.resize((round_count + 1) * stop_count);
+            parents.resize((round_count + 1) * stop_count);
+            std::copy_n(labels.begin() + (round_count - 1) * stop_count, stop_count, labels.begin() + round_count * stop_count);
+            std::copy_n(parents.begin() + (round_count - 1) * stop_count, stop_count, parents.begin() + round_count * stop_count);
+            ++round_count;
+        }
+
+        double& Label(size_t round, StopId stop) {
+            return labels[round * stop_count + stop];
+        }
+
+        Parent& ParentOf(size_t round, StopId stop) {
+            return parents[round * stop_count + stop];
+        }
+    };
+
+    Raptor::Raptor(const catalogue::TransportCatalogue& catalogue, double bus_wait_time, double meters_per_minute)
+        : bus_wait_time_(bus_wait_time), meters_per_minute_(meters_per_minute)
+    {
+        stops_ = catalogue.GetStops();
+        buses_ = catalogue.GetBuses();
+        route_offsets_.reserve(buses_.size() + 1);
+        route_offsets_.push_back(0);
+        for (const auto& bus : buses_) {
+            const auto stops = catalogue.GetBusStopIds(bus->id);
+            const auto prefix = catalogue.GetBusRoadPrefix(bus->id);
+            route_stops_.insert(route_stops_.end(), stops.begin(), stops.end());
+            route_prefix_distances_.insert(route_prefix_distances_.end(), prefix.begin(), prefix.end());
+            route_offsets_.push_back(route_stops_.size());
+        }
+
+        // Counting sort of every route position by stop. Routes and positions are scattered in
+        // order, so the (route, position) pairs of each stop come out sorted.
+        stop_offsets_.assign(stops_.size() + 1, 0);
+        for (const StopId stop : route_stops_) {
+            ++stop_offsets_[stop + 1];
+        }
+        for (size_t i = 1; i < stop_offsets_.size(); ++i) {
+            stop_offsets_[i] += stop_offsets_[i - 1];
+        }
+
+        stop_routes_.resize(route_stops_.size());
+        std::vector<size_t> next(stop_offsets_.begin(), std::prev(stop_offsets_.end()));
+        for (RouteId route = 0; route < buses_.size(); ++route) {
+            for (size_t position = route_offsets_[route]; position < route_offsets_[route + 1]; ++position) {
+                stop_routes_[next[route_stops_[position]]++] = { route, static_cast<uint32_t>(position - route_offsets_[route]) };
+            }
+        }
+    }
+
+    StopId Raptor::GetStopId(const Stop* stop) const {
+        return stop->id;
+    }
+
+    double Raptor::ComputeTravelTime(int distance) const {
+        return distance / meters_per_minute_;
+    }
+
+    void Raptor::Search(SearchSpace& space, StopId from, std::optional<StopId> target_pruning, double max_time) const {
+        space.Reset(stop_offsets_.size() - 1, buses_.size());
+        space.Label(0, from) = 0;
+        space.best[from] = 0;
+        space.marked.push_back(from);
+
+        for (size_t round = 1; !space.marked.empty(); ++round) {
+            space.AddRound();
+
+            // Queue every route through a marked stop, from its earliest marked position
+            for (const StopId stop : space.marked) {
+                space.is_marked[stop] = 0;
+                for (size_t i = stop_offsets_[stop]; i < stop_offsets_[stop + 1]; ++i) {
+                    const auto [route, position] = stop_routes_[i];
+                    if (space.route_start[route] == NO_POSITION) {
+                        space.queued_routes.push_back(route);
+                        space.route_start[route] = position;
+                    }
+                    else {
+                        space.route_start[route] = std::min(space.route_start[route], position);
+                    }
+                }
+            }
+            space.marked.clear();
+            std::sort(space.queued_routes.begin(), space.queued_routes.end());
+
+            for (const RouteId route : space.queued_routes) {
+                const size_t offset = route_offsets_[route];
+                const size_t length = route_offsets_[route + 1] - offset;
+                const StopId* stops = &route_stops_[offset];
+                const int* prefix_distances = &route_prefix_distances_[offset];
+
+                uint32_t board = NO_POSITION;
+                double board_time = UNREACHED;
+                for (uint32_t position = space.route_start[route]; position < length; ++position) {
+                    const StopId stop = stops[position];
+
+                    double riding_time = UNREACHED;
+                    if (board != NO_POSITION) {
+                        riding_time = board_time + ComputeTravelTime(prefix_distances[position] - prefix_distances[board]);
+                        const double bound = target_pruning ? std::min(space.best[stop], space.best[*target_pruning]) : space.best[stop];
+                        if (riding_time < bound && riding_time <= max_time) {
+                            space.Label(round, stop) = riding_time;
+                            space.ParentOf(round, stop) = { route, board, position, static_cast<uint32_t>(round) };
+                            space.best[stop] = riding_time;
+                            if (!space.is_marked[stop]) {
+                                space.is_marked[stop] = 1;
+                                space.marked.push_back(stop);
+                            }
+                        }
+                    }
+
+                    // Boarding here after the previous round beats staying on board
+                    const double previous = space.Label(round - 1, stop);
+                    if (previous != UNREACHED && previous + bus_wait_time_ < riding_time) {
+                        board = position;
+                        board_time = previous + bus_wait_time_;
+                    }
+                }
+                space.route_start[route] = NO_POSITION;
+            }
+            space.queued_routes.clear();
+        }
+    }
+
+    std::optional<Journey> Raptor::ExtractJourney(const SearchSpace& space, StopId from, StopId to) const {
+        if (space.best[to] == UNREACHED) {
+            return std::nullopt;
+        }
+
+        Journey journey;
+        size_t round = space.round_count - 1;
+        StopId stop = to;
+        while (stop != from) {
+            const Parent& parent = space.parents[round * space.stop_count + stop];
+            const RouteId route = parent.route;
+            const size_t offset = route_offsets_[route];
+            journey.push_back({ buses_[route], parent.board, parent.alight,
+                route_prefix_distances_[offset + parent.alight] - route_prefix_distances_[offset + parent.board] });
+            stop = route_stops_[offset + parent.board];
+            round = parent.round - 1;
+        }
+        std::reverse(journey.begin(), journey.end());
+        return journey;
+    }
+
+    std::optional<Journey> Raptor::ComputeJourney(const Stop* from, const Stop* to) const {
+        thread_local SearchSpace space;
+        const StopId from_id = GetStopId(from);
+        const StopId to_id = GetStopId(to);
+        Search(space, from_id, to_id, UNREACHED);
+        return ExtractJourney(space, from_id, to_id);
+    }
+
+    std::vector<std::optional<Journey>> Raptor::ComputeJourneys(const Stop* from, const std::vector<const Stop*>& targets) const {
+        thread_local SearchSpace space;
+        const StopId from_id = GetStopId(from);
+        Search(space, from_id, std::nullopt, UNREACHED);
+
+        std::vector<std::optional<Journey>> journeys;
+        journeys.reserve(targets.size());
+        for (const auto& target : targets) {
+            journeys.push_back(ExtractJourney(space, from_id, GetStopId(target)));
+        }
+        return journeys;
+    }
+
+    std::vector<std::optional<double>> Raptor::ComputeTravelTimes(const Stop* from, const std::vector<const Stop*>& targets) const {
+        thread_local SearchSpace space;
+        Search(space, GetStopId(from), std::nullopt, UNREACHED);
+
+        std::vector<std::optional<double>> times;
+        times.reserve(targets.size());
+        for (const auto& target : targets) {
+            const double time = space.best[GetStopId(target)];
+            if (time == UNREACHED) {
+                times.push_back(std::nullopt);
+            }
+            else {
+                times.push_back(time);
+            }
+        }
+        return times;
+    }
+
+    std::vector<std::pair<const Stop*, double>> Raptor::ComputeReachableStops(const Stop* from, double max_time) const {
+        thread_local SearchSpace space;
+        Search(space, GetStopId(from), std::nullopt, max_time);
+
+        std::vector<std::pair<const Stop*, double>> result;
+        for (StopId stop = 0; stop < stops_.size(); ++stop) {
+            if (space.best[stop] <= max_time) {
+                result.push_back({ stops_[stop], space.best[stop] });
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "domain.h"
+#include "transport_catalogue.h"
+
+namespace router {
+
+    // One ride of a journey: route positions `board` to `alight` of the bus
+    struct JourneyLeg {
+        const Bus* bus;
+        size_t board;
+        size_t alight;
+        int distance;
+    };
+
+    using Journey = std::vector<JourneyLeg>;
+
+    // Round-based transit routing (RAPTOR) straight over the catalogue buses, no graph needed.
+    // Round k finds the best arrival at every stop with exactly k rides: only routes through
+    // stops improved in round k - 1 are scanned, each from its earliest improved position.
+    // Every boarding costs bus_wait_time and a ride costs its road distance over the speed,
+    // as in the graph models, so total times are the same.
+    // Routes and the stop -> (route, position) index are flat arrays built in one linear pass.
+    class Raptor {
+    public:
+        Raptor(const catalogue::TransportCatalogue& catalogue, double bus_wait_time, double meters_per_minute);
+
+        // Costs are applied at query time, so new settings need no rebuild
+        void SetCosts(double bus_wait_time, double meters_per_minute) {
+            bus_wait_time_ = bus_wait_time;
+            meters_per_minute_ = meters_per_minute;
+        }
+
+        // Best journey from `from` to `to`; std::nullopt if `to` is unreachable
+        std::optional<Journey> ComputeJourney(const Stop* from, const Stop* to) const;
+        // One search from `from` for all targets; result i is the journey to targets[i]
+        std::vector<std::optional<Journey>> ComputeJourneys(const Stop* from, const std::vector<const Stop*>& targets) const;
+        // Travel times only, from one search; std::nullopt for unreachable targets
+        std::vector<std::optional<double>> ComputeTravelTimes(const Stop* from, const std::vector<const Stop*>& targets) const;
+        // Best arrival time at every stop reachable within max_time, `from` included, in stop order
+        std::vector<std::pair<const Stop*, double>> ComputeReachableStops(const Stop* from, double max_time) const;
+
+    private:
+        // Route ids are the catalogue BusIds
+        using RouteId = uint32_t;
+
+        struct RouteStop {
+            RouteId route;
+            uint32_t position;
+        };
+
+        // Ride that set a label: route positions board..alight, taken in round `round`
+        struct Parent {
+            RouteId route;
+            uint32_t board;
+            uint32_t alight;
+            uint32_t round;
+        };
+
+        struct SearchSpace;
+
+        static constexpr uint32_t NO_POSITION = static_cast<uint32_t>(-1);
+
+        StopId GetStopId(const Stop* stop) const;
+        double ComputeTravelTime(int distance) const;
+        // Runs rounds until no label improves; labels are never set past best[target_pruning] or max_time
+        void Search(SearchSpace& space, StopId from, std::optional<StopId> target_pruning, double max_time) const;
+        std::optional<Journey> ExtractJourney(const SearchSpace& space, StopId from, StopId to) const;
+
+        double bus_wait_time_;
+        double meters_per_minute_;
+
+        std::vector<const Stop*> stops_;
+        std::vector<const Bus*> buses_;
+
+        // Route r is positions route_offsets_[r]..route_offsets_[r + 1] of the arrays below
+        std::vector<size_t> route_offsets_;
+        std::vector<StopId> route_stops_;
+        // Road distance from the first stop of the route
+        std::vector<int> route_prefix_distances_;
+
+        // Stop s is served at stop_routes_[stop_offsets_[s]..stop_offsets_[s + 1]]
+        std::vector<size_t> stop_offsets_;
+        std::vector<RouteStop> stop_routes_;
+    };
+
+}
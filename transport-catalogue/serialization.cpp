@@ -0,0 +1,121 @@
+#include "serialization.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace serialization {
+
+    namespace {
+
+        constexpr uint64_t MULTIPLIER = 0x9e3779b97f4a7c15ull;
+        constexpr char PADDING[8] = {};
+
+        uint64_t Mix(uint64_t hash, uint64_t word) {
+            hash ^= word;
+            hash *= MULTIPLIER;
+            return hash ^ (hash >> 32);
+        }
+
+        size_t PaddingFor(size_t size) {
+            return (8 - size % 8) % 8;
+        }
+
+        // Next to the target, so the rename stays on one file system. Processes that start together
+        // on a cold cache write the same file; each needs a temporary file of its own.
+        std::string MakeTempPath(const std::string& path) {
+            std::random_device random;
+            const uint64_t suffix = static_cast<uint64_t>(random()) << 32 | random();
+            return path + ".tmp." + std::to_string(suffix);
+        }
+
+    }
+
+    void Hasher::Add(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        size_t pos = 0;
+        for (; pos + 8 <= size; pos += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + pos, 8);
+            hash_ = Mix(hash_, word);
+        }
+        if (pos < size) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + pos, size - pos);
+            hash_ = Mix(hash_, word ^ (static_cast<uint64_t>(size - pos) << 56));
+        }
+    }
+
+    Writer::Writer(const std::string& path, uint64_t fingerprint)
+        : path_(path), temp_path_(MakeTempPath(path)), out_(temp_path_, std::ios::binary | std::ios::trunc), header_{}
+    {
+        std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+        header_.version = VERSION;
+        header_.fingerprint = fingerprint;
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    }
+
+    void Writer::WriteBytes(const void* data, size_t size) {
+        const uint64_t size_field = size;
+        out_.write(reinterpret_cast<const char*>(&size_field), sizeof(size_field));
+        out_.write(static_cast<const char*>(data), size);
+        out_.write(PADDING, PaddingFor(size));
+
+        checksum_.Add(size_field);
+        checksum_.Add(data, size);
+        header_.payload_size += sizeof(size_field) + size + PaddingFor(size);
+        ++header_.section_count;
+    }
+
+    bool Writer::Finish() {
+        header_.checksum = checksum_.GetHash();
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        out_.close();
+        if (!out_ || std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+            std::remove(temp_path_.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    Reader::Reader(const std::string& path, uint64_t fingerprint)
+        : in_(path, std::ios::binary), header_{}
+    {
+        if (!in_.read(reinterpret_cast<char*>(&header_), sizeof(header_))) {
+            return;
+        }
+        valid_ = std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) == 0
+            && header_.version == VERSION
+            && header_.fingerprint == fingerprint;
+    }
+
+    bool Reader::ReadSize(uint64_t& size) {
+        if (!valid_ || sections_read_ == header_.section_count) {
+            return false;
+        }
+        if (!in_.read(reinterpret_cast<char*>(&size), sizeof(size)) || size > header_.payload_size) {
+            return false;
+        }
+        checksum_.Add(size);
+        return true;
+    }
+
+    bool Reader::ReadBytes(void* data, size_t size) {
+        char padding[8];
+        if (!in_.read(static_cast<char*>(data), size) || !in_.read(padding, PaddingFor(size))) {
+            valid_ = false;
+            return false;
+        }
+        checksum_.Add(data, size);
+        ++sections_read_;
+        return true;
+    }
+
+    bool Reader::Finish() {
+        return valid_
+            && sections_read_ == header_.section_count
+            && checksum_.GetHash() == header_.checksum;
+    }
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Binary file of POD sections with a fixed header:
+//   Header (48 bytes) | section 0 | section 1 | ...
+// Every section is a uint64 byte size followed by the raw array, padded to 8 bytes, so a
+// reader that maps the file can point straight into it. Values are stored in native byte order.
+// The header holds a caller-defined fingerprint of the data the file was built from and
+// a checksum of all section bytes; a file that does not match either is rejected.
+namespace serialization {
+
+    inline constexpr char MAGIC[8] = { 'T', 'C', 'R', 'O', 'U', 'T', 'E', 'R' };
+    inline constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t section_count;
+        uint64_t fingerprint;
+        uint64_t checksum;
+        uint64_t payload_size;
+        uint64_t reserved;
+    };
+
+    class Hasher {
+    public:
+        void Add(const void* data, size_t size);
+
+        void Add(std::string_view str) {
+            Add(static_cast<uint64_t>(str.size()));
+            Add(str.data(), str.size());
+        }
+
+        template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+        void Add(T value) {
+            Add(&value, sizeof(value));
+        }
+
+        uint64_t GetHash() const {
+            return hash_;
+        }
+
+    private:
+        uint64_t hash_ = 0xcbf29ce484222325ull;
+    };
+
+    class Writer {
+    public:
+        Writer(const std::string& path, uint64_t fingerprint);
+
+        template <typename T>
+        void WriteSection(const std::vector<T>& data) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            WriteBytes(data.data(), data.size() * sizeof(T));
+        }
+
+        // Writes the header and moves the file into place; false if anything failed
+        bool Finish();
+
+    private:
+        void WriteBytes(const void* data, size_t size);
+
+        std::string path_;
+        std::string temp_path_;
+        std::ofstream out_;
+        Header header_;
+        Hasher checksum_;
+    };
+
+    class Reader {
+    public:
+        Reader(const std::string& path, uint64_t fingerprint);
+
+        bool IsValid() const {
+            return valid_;
+        }
+
+        template <typename T>
+        bool ReadSection(std::vector<T>& data) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            uint64_t size = 0;
+            if (!ReadSize(size) || size % sizeof(T) != 0) {
+                valid_ = false;
+                return false;
+            }
+            data.resize(size / sizeof(T));
+            return ReadBytes(data.data(), size);
+        }
+
+        // True if every section was read and the checksum matches
+        bool Finish();
+
+    private:
+        bool ReadSize(uint64_t& size);
+        bool ReadBytes(void* data, size_t size);
+
+        std::ifstream in_;
+        Header header_;
+        Hasher checksum_;
+        uint32_t sections_read_ = 0;
+        bool valid_ = false;
+    };
+
+}
@@ -2,7 +2,6 @@
 
 #include <iomanip>
 #include <iostream>
-#include <set>
 
 using namespace std::literals;
 using namespace catalogue;
@@ -49,17 +48,13 @@ void PrintStop(const TransportCatalogue& tansport_catalogue, std::string_view na
     if (!stop_data.has_value()) {
         output << ": not found"s << '\n';
     }
-    else if (stop_data.value().get().empty()) {
+    else if (stop_data.value().empty()) {
         output << ": no buses"s << '\n';
     }
     else {
-        std::set<std::string_view> res;
-        for (auto bus : stop_data.value().get()) {
-            res.insert(bus->name);
-        }
         output << ": buses ";
-        for (auto iter = res.cbegin(); iter != res.cend(); ++iter) {
-            output << *iter << ' ';
+        for (const BusId bus : stop_data.value()) {
+            output << tansport_catalogue.GetBus(bus)->name << ' ';
         }
         output << '\n';
     }
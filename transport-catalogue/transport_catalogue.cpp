@@ -1,4 +1,7 @@
 #include "transport_catalogue.h"
+#include "parallel.h"
+
+#include <algorithm>
 
 
 namespace catalogue {
@@ -23,12 +26,17 @@ namespace catalogue {
         }
     }
 
-    std::optional<std::reference_wrapper<const std::unordered_set<Bus*>>> TransportCatalogue::FindBusesByStop(const std::string_view name) const {
+    std::optional<std::span<const BusId>> TransportCatalogue::FindBusesByStop(const std::string_view name) const {
         auto stop = FindStopByName(name);
         if (stop == nullptr) {
             return std::nullopt;
         }
-        return std::ref(buses_by_stop_.at(stop));
+        return GetBusesByStop(stop->id);
+    }
+
+    std::span<const BusId> TransportCatalogue::GetBusesByStop(StopId id) const {
+        BuildStopBusIndex();
+        return std::span<const BusId>(stop_buses_).subspan(stop_bus_offsets_[id], stop_bus_offsets_[id + 1] - stop_bus_offsets_[id]);
     }
 
     BusData TransportCatalogue::GetBusData(const std::string& name) const {
@@ -37,61 +45,141 @@ namespace catalogue {
         if (bus == nullptr) {
             return result;
         }
+        if (finalized_) {
+            return bus_data_[bus->id];
+        }
+        return ComputeBusData(*bus);
+    }
 
-        result.name = bus->name;
-        result.number_of_stops = bus->stops.size();
+    // Resolves the reverse-direction fallback of every segment once
+    void TransportCatalogue::ComputeBusPrefixes(BusId id) {
+        const size_t begin = bus_stop_offsets_[id];
+        const size_t end = bus_stop_offsets_[id + 1];
 
-        std::unordered_set<const Stop*> unique_stops_set;
-        for (const auto& stop : bus->stops) {
-            unique_stops_set.insert(stop);
+        int road = 0;
+        double geo = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (i != begin) {
+                const int distance = GetRoadDistance(bus_stops_[i - 1], bus_stops_[i]);
+                if (distance != -1) {
+                    road += distance;
+                }
+                geo += ComputeDistance(stop_coords_[bus_stops_[i - 1]], stop_coords_[bus_stops_[i]]);
+            }
+            bus_road_prefix_[i] = road;
+            bus_geo_prefix_[i] = geo;
+            bus_stop_positions_[i] = { bus_stops_[i], static_cast<uint32_t>(i - begin) };
         }
-        result.number_of_unique_stops = unique_stops_set.size();
-
-        int length = 0;
+        std::sort(bus_stop_positions_.begin() + begin, bus_stop_positions_.begin() + end);
+    }
 
-        unsigned int res = 0;
+    BusData TransportCatalogue::ComputeBusData(const Bus& bus) const {
+        BusData result;
+        result.name = bus.name;
+        result.number_of_stops = bus_stop_offsets_[bus.id + 1] - bus_stop_offsets_[bus.id];
 
-        for (auto iter = bus->stops.begin(); iter != std::prev(bus->stops.end()); ++iter) {
-            auto it = distances_.find({ *iter, *(std::next(iter)) });
-            if (it != distances_.end()) {
-                length += (*it).second;
-                //
-                res += (*it).second;
+        const auto positions = std::span(bus_stop_positions_).subspan(bus_stop_offsets_[bus.id], result.number_of_stops);
+        result.number_of_unique_stops = 0;
+        for (size_t i = 0; i < positions.size(); ++i) {
+            if (i == 0 || positions[i].first != positions[i - 1].first) {
+                ++result.number_of_unique_stops;
             }
-            else {
-                it = distances_.find({ *(std::next(iter)), *iter });
-                if (it != distances_.end()) {
-                    length += (*it).second;
-                    //
-                    res += (*it).second;
+        }
+
+        const auto road_prefix = GetBusRoadPrefix(bus.id);
+        const auto geo_prefix = GetBusGeoPrefix(bus.id);
+        result.route_length = road_prefix.empty() ? 0 : road_prefix.back();
+        result.geo_length = geo_prefix.empty() ? 0 : geo_prefix.back();
+        result.curvature = result.route_length / result.geo_length;
+
+        return result;
+    }
+
+    void TransportCatalogue::Finalize(int thread_count) {
+        bus_data_.resize(buses_.size());
+        parallel::ForEachIndex(buses_.size(), parallel::ResolveThreadCount(thread_count), [&](size_t i) {
+            bus_data_[i] = ComputeBusData(buses_[i]);
+        });
+        BuildStopBusIndex();
+        finalized_ = true;
+    }
+
+    // Counting sort into per-stop ranges. Buses are visited in name order, so every range comes
+    // out sorted; the sorted (stop, position) pairs of a bus give each of its stops once.
+    void TransportCatalogue::BuildStopBusIndex() const {
+        // Lookups after Finalize() or a first build see the flag set and skip the mutex
+        if (stop_bus_index_built_.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard guard(stop_bus_index_mutex_);
+        if (stop_bus_index_built_.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        std::vector<BusId> buses_by_name(buses_.size());
+        for (BusId id = 0; id < buses_by_name.size(); ++id) {
+            buses_by_name[id] = id;
+        }
+        std::sort(buses_by_name.begin(), buses_by_name.end(), [this](BusId lhs, BusId rhs) {
+            return buses_[lhs].name < buses_[rhs].name;
+        });
+
+        auto for_each_unique_stop = [this](BusId id, auto func) {
+            for (size_t i = bus_stop_offsets_[id]; i < bus_stop_offsets_[id + 1]; ++i) {
+                if (i == bus_stop_offsets_[id] || bus_stop_positions_[i].first != bus_stop_positions_[i - 1].first) {
+                    func(bus_stop_positions_[i].first);
                 }
             }
+        };
+
+        stop_bus_offsets_.assign(stops_.size() + 1, 0);
+        for (const BusId bus : buses_by_name) {
+            for_each_unique_stop(bus, [this](StopId stop) {
+                ++stop_bus_offsets_[stop + 1];
+            });
+        }
+        for (size_t i = 1; i < stop_bus_offsets_.size(); ++i) {
+            stop_bus_offsets_[i] += stop_bus_offsets_[i - 1];
         }
-        result.route_length = length;
 
-        double geo_length = 0;
-        for (auto iter = bus->stops.begin(); iter != std::prev(bus->stops.end()); ++iter) {
-            geo_length += ComputeDistance((*iter)->coords, (*std::next(iter))->coords);
+        stop_buses_.resize(stop_bus_offsets_.back());
+        std::vector<size_t> next(stop_bus_offsets_.begin(), std::prev(stop_bus_offsets_.end()));
+        for (const BusId bus : buses_by_name) {
+            for_each_unique_stop(bus, [&](StopId stop) {
+                stop_buses_[next[stop]++] = bus;
+            });
         }
-        result.curvature = length / geo_length;
+        stop_bus_index_built_.store(true, std::memory_order_release);
+    }
 
-        return result;
+    bool TransportCatalogue::IsFinalized() const {
+        return finalized_;
     }
 
-    void TransportCatalogue::AddStop(const std::string& name, geo::Coordinates coords) {
-        stops_.push_back({ std::move(name), std::move(coords) });
+    void TransportCatalogue::AddStop(const std::string_view name, geo::Coordinates coords) {
+        stops_.push_back({ static_cast<StopId>(stops_.size()), names_.Intern(name) });
         stops_ptrs_.insert({ stops_.back().name, &stops_.back() });
-
-        buses_by_stop_.insert({ &stops_.back(), std::unordered_set<Bus*>() });
+        stop_coords_.push_back(coords);
+        finalized_ = false;
+        stop_bus_index_built_.store(false, std::memory_order_relaxed);
     }
 
-    void TransportCatalogue::AddBus(const std::string& name, const std::vector<const Stop*>& stops, bool is_roundtrip) {
-        buses_.push_back({ std::move(name), std::move(stops), is_roundtrip });
+    void TransportCatalogue::AddBus(const std::string_view name, const std::vector<const Stop*>& stops, bool is_roundtrip, std::vector<double> trip_start_times) {
+        std::sort(trip_start_times.begin(), trip_start_times.end());
+        buses_.push_back({ static_cast<BusId>(buses_.size()), names_.Intern(name), is_roundtrip, std::move(trip_start_times) });
         buses_ptrs_.insert({ buses_.back().name, &buses_.back() });
+        finalized_ = false;
+        stop_bus_index_built_.store(false, std::memory_order_relaxed);
 
-        for (auto stop : buses_.back().stops) {
-            buses_by_stop_.at(stop).insert(&buses_.back());
+        for (auto stop : stops) {
+            bus_stops_.push_back(stop->id);
         }
+        bus_stop_offsets_.push_back(bus_stops_.size());
+
+        bus_road_prefix_.resize(bus_stops_.size());
+        bus_geo_prefix_.resize(bus_stops_.size());
+        bus_stop_positions_.resize(bus_stops_.size());
+        ComputeBusPrefixes(buses_.back().id);
     }
 
     void TransportCatalogue::AddDistance(const std::string_view from_stop, const std::string_view to_stop, int distance) {
@@ -103,7 +191,17 @@ namespace catalogue {
             throw("ErrorAddDistance");
         }
 
-        distances_.insert({ {from_stop_ptr, to_stop_ptr}, distance });
+        distances_.Insert(from_stop_ptr->id, to_stop_ptr->id, distance);
+        finalized_ = false;
+
+        // Buses added before the distance may ride between the two stops, in either direction
+        if (!buses_.empty()) {
+            for (const BusId bus : GetBusesByStop(from_stop_ptr->id)) {
+                if (FindStopPosition(bus, to_stop_ptr->id).has_value()) {
+                    ComputeBusPrefixes(bus);
+                }
+            }
+        }
     }
 
     int TransportCatalogue::GetDistanceBetweenStops(const std::string_view from, const std::string_view to) const {
@@ -112,13 +210,18 @@ namespace catalogue {
     }
 
     int TransportCatalogue::GetDistanceBetweenStops(const Stop* from, const Stop* to) const {
-        auto iter = distances_.find({ from, to });
-        if (iter != distances_.end()) {
-            return (*iter).second;
-        }
-        else {
+        if (from == nullptr || to == nullptr) {
             return -1;
         }
+        return GetDistanceBetweenStops(from->id, to->id);
+    }
+
+    int TransportCatalogue::GetDistanceBetweenStops(StopId from, StopId to) const {
+        return distances_.Find(from, to).value_or(-1);
+    }
+
+    int TransportCatalogue::GetRoadDistance(StopId from, StopId to) const {
+        return distances_.FindEither(from, to).value_or(-1);
     }
 
     std::vector<const Bus*> TransportCatalogue::GetBuses() const {
@@ -136,8 +239,92 @@ namespace catalogue {
         return stops;
     }
 
+    size_t TransportCatalogue::GetStopCount() const {
+        return stops_.size();
+    }
+
+    size_t TransportCatalogue::GetBusCount() const {
+        return buses_.size();
+    }
+
+    const Stop* TransportCatalogue::GetStop(StopId id) const {
+        return &stops_[id];
+    }
+
+    const Bus* TransportCatalogue::GetBus(BusId id) const {
+        return &buses_[id];
+    }
+
+    std::string_view TransportCatalogue::GetStopName(StopId id) const {
+        return stops_[id].name;
+    }
+
+    const NameArena& TransportCatalogue::GetNames() const {
+        return names_;
+    }
+
+    std::string_view TransportCatalogue::InternName(std::string_view name) {
+        return names_.Intern(name);
+    }
+
+    std::span<const geo::Coordinates> TransportCatalogue::GetStopCoordinates() const {
+        return stop_coords_;
+    }
+
+    std::span<const StopId> TransportCatalogue::GetBusStopIds(BusId id) const {
+        return std::span<const StopId>(bus_stops_).subspan(bus_stop_offsets_[id], bus_stop_offsets_[id + 1] - bus_stop_offsets_[id]);
+    }
+
+    std::span<const int> TransportCatalogue::GetBusRoadPrefix(BusId id) const {
+        return std::span<const int>(bus_road_prefix_).subspan(bus_stop_offsets_[id], bus_stop_offsets_[id + 1] - bus_stop_offsets_[id]);
+    }
+
+    std::span<const double> TransportCatalogue::GetBusGeoPrefix(BusId id) const {
+        return std::span<const double>(bus_geo_prefix_).subspan(bus_stop_offsets_[id], bus_stop_offsets_[id + 1] - bus_stop_offsets_[id]);
+    }
+
+    std::optional<size_t> TransportCatalogue::FindStopPosition(BusId id, StopId stop, size_t from_position) const {
+        const auto begin = bus_stop_positions_.begin() + bus_stop_offsets_[id];
+        const auto end = bus_stop_positions_.begin() + bus_stop_offsets_[id + 1];
+        const auto it = std::lower_bound(begin, end, std::pair<StopId, uint32_t>{ stop, static_cast<uint32_t>(from_position) });
+        if (it == end || it->first != stop) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    int TransportCatalogue::GetDistanceAlongBus(BusId id, size_t from_position, size_t to_position) const {
+        const auto road_prefix = GetBusRoadPrefix(id);
+        return road_prefix[to_position] - road_prefix[from_position];
+    }
+
+    std::optional<int> TransportCatalogue::GetDistanceAlongBus(const std::string_view bus, const std::string_view from, const std::string_view to) const {
+        const Bus* bus_ptr = FindBusByName(bus);
+        const Stop* from_ptr = FindStopByName(from);
+        const Stop* to_ptr = FindStopByName(to);
+        if (bus_ptr == nullptr || from_ptr == nullptr || to_ptr == nullptr) {
+            return std::nullopt;
+        }
+
+        // A stop the route passes more than once, as every stop but the terminal of a
+        // non-roundtrip bus, may start the ride at any of its visits
+        std::optional<int> result;
+        for (auto from_position = FindStopPosition(bus_ptr->id, from_ptr->id); from_position.has_value();
+            from_position = FindStopPosition(bus_ptr->id, from_ptr->id, from_position.value() + 1)) {
+            const auto to_position = FindStopPosition(bus_ptr->id, to_ptr->id, from_position.value());
+            if (!to_position.has_value()) {
+                break;
+            }
+            const int distance = GetDistanceAlongBus(bus_ptr->id, from_position.value(), to_position.value());
+            if (!result.has_value() || distance < result.value()) {
+                result = distance;
+            }
+        }
+        return result;
+    }
+
 
-    std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopsPairHasher> TransportCatalogue::GetAllDistances() const {
+    const DistanceTable& TransportCatalogue::GetAllDistances() const {
         return distances_;
     }
 }
\ No newline at end of file
@@ -1,15 +1,20 @@
 #pragma once
 
 #include "geo.h"
+#include "distance_table.h"
 #include "domain.h"
+#include "name_arena.h"
 
+#include <atomic>
+#include <cstdint>
 #include <deque>
+#include <span>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <optional>
 #include <functional>
+#include <mutex>
 
 namespace catalogue {
 
@@ -18,45 +23,112 @@ namespace catalogue {
 		int number_of_stops;
 		int number_of_unique_stops;
 		int route_length;
+		double geo_length;
 		double curvature;
 	};
 
-	class StopsPairHasher {
-	public:
-		size_t operator()(std::pair<const Stop*, const Stop*> stops_pair) const {
-			return (std::hash<const void*>{}(stops_pair.first) ^ (std::hash<const void*>{}(stops_pair.second)) >> 1);
-		}
-	};
-
 	class TransportCatalogue {
 		// Реализуйте класс самостоятельно
 	public:
 		const Bus* FindBusByName(const std::string_view name) const;
 		const Stop* FindStopByName(const std::string_view name) const;
-		std::optional<std::reference_wrapper<const std::unordered_set<Bus*>>> FindBusesByStop(const std::string_view name) const;
+		// Buses through the stop, each once, sorted by name; std::nullopt for an unknown stop.
+		// The index is built by Finalize(), or by the first call after a stop or a bus is added.
+		std::optional<std::span<const BusId>> FindBusesByStop(const std::string_view name) const;
+		std::span<const BusId> GetBusesByStop(StopId id) const;
 
+		// O(1) once the catalogue is finalized, computed on the spot otherwise
 		BusData GetBusData(const std::string& name) const;
-		std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopsPairHasher> GetAllDistances() const;
+		// Every road distance as set, without a copy
+		const DistanceTable& GetAllDistances() const;
+		// Distance set for this direction, -1 if none
 		int GetDistanceBetweenStops(const std::string_view from, const std::string_view to) const;
 		int GetDistanceBetweenStops(const Stop* from, const Stop* to) const;
+		int GetDistanceBetweenStops(StopId from, StopId to) const;
+		// Distance for this direction, else the reverse one, -1 if neither is set
+		int GetRoadDistance(StopId from, StopId to) const;
 
-		void AddStop(const std::string& name, geo::Coordinates coords);
-		void AddBus(const std::string& name, const std::vector<const Stop*>& stops, bool is_roundtrip);
+		void AddStop(const std::string_view name, geo::Coordinates coords);
+		// Only the ids of `stops` are kept
+		void AddBus(const std::string_view name, const std::vector<const Stop*>& stops, bool is_roundtrip, std::vector<double> trip_start_times = {});
 		void AddDistance(const std::string_view from_stop, const std::string_view to_stop, int distance);
 
+		// Computes the statistics of every bus once, on thread_count threads (0 for all of them),
+		// and the stop -> buses index. Adding a stop, a bus or a distance afterwards drops the
+		// statistics until the next Finalize().
+		void Finalize(int thread_count = 0);
+		bool IsFinalized() const;
+
 		std::vector<const Bus*> GetBuses() const;
 		std::vector<const Stop*> GetStops() const;
 
+		// Ids run from 0 to count - 1 in insertion order, the order of GetStops() and GetBuses()
+		size_t GetStopCount() const;
+		size_t GetBusCount() const;
+		const Stop* GetStop(StopId id) const;
+		const Bus* GetBus(BusId id) const;
+		std::string_view GetStopName(StopId id) const;
+		// Coordinates of every stop, indexed by StopId
+		std::span<const geo::Coordinates> GetStopCoordinates() const;
+		// Stops of the bus route in order, as ids
+		std::span<const StopId> GetBusStopIds(BusId id) const;
+
+		// Road and straight-line distance from the first stop of the bus, one entry per route position.
+		// A segment without a road distance in its own direction takes the reverse one, 0 if neither is set.
+		std::span<const int> GetBusRoadPrefix(BusId id) const;
+		std::span<const double> GetBusGeoPrefix(BusId id) const;
+		// First route position >= from_position where the bus stops at `stop`
+		std::optional<size_t> FindStopPosition(BusId id, StopId stop, size_t from_position = 0) const;
+		// Road distance riding the bus between two route positions, from_position <= to_position
+		int GetDistanceAlongBus(BusId id, size_t from_position, size_t to_position) const;
+		// Shortest road distance riding `bus` from any of its stops at `from` to the next stop at `to`,
+		// so the return leg of a non-roundtrip bus counts; std::nullopt if a name is unknown or `to`
+		// never follows `from` on the route
+		std::optional<int> GetDistanceAlongBus(const std::string_view bus, const std::string_view from, const std::string_view to) const;
+
+		// Every stop and bus name, stored once
+		const NameArena& GetNames() const;
+		// Stores a name ahead of AddStop/AddBus; they intern to the same view
+		std::string_view InternName(std::string_view name);
+
 	private:
+		void ComputeBusPrefixes(BusId id);
+		// Builds the stop -> buses index unless it is up to date
+		void BuildStopBusIndex() const;
+		BusData ComputeBusData(const Bus& bus) const;
+
+		NameArena names_;
+
 		std::deque<Stop> stops_;
 		std::deque<Bus> buses_;
 
 		std::unordered_map<std::string_view, Stop*> stops_ptrs_;
 		std::unordered_map<std::string_view, Bus*> buses_ptrs_;
 
-		std::unordered_map<std::pair<const Stop*, const Stop*>, int, StopsPairHasher> distances_;
+		// Per-stop and per-bus data by id, as structure of arrays: the hot loops of the router
+		// and the renderer read them without touching the Stop and Bus objects, which hold
+		// only the id, the name and the timetable
+		std::vector<geo::Coordinates> stop_coords_;
+		// Stops of bus b are bus_stops_[bus_stop_offsets_[b]..bus_stop_offsets_[b + 1]]
+		std::vector<size_t> bus_stop_offsets_ = { 0 };
+		std::vector<StopId> bus_stops_;
+		// Same layout as bus_stops_
+		std::vector<int> bus_road_prefix_;
+		std::vector<double> bus_geo_prefix_;
+		// (stop, position) pairs of every bus slice, sorted, for position lookups
+		std::vector<std::pair<StopId, uint32_t>> bus_stop_positions_;
+
+		DistanceTable distances_;
+
+		// Buses of stop s are stop_buses_[stop_bus_offsets_[s]..stop_bus_offsets_[s + 1]], by name
+		mutable std::mutex stop_bus_index_mutex_;
+		mutable std::vector<size_t> stop_bus_offsets_;
+		mutable std::vector<BusId> stop_buses_;
+		mutable std::atomic<bool> stop_bus_index_built_ = false;
 
-		std::unordered_map<const Stop*, std::unordered_set<Bus*>> buses_by_stop_;
+		// Statistics by BusId, filled by Finalize()
+		std::vector<BusData> bus_data_;
+		bool finalized_ = false;
 	};
 
 }
\ No newline at end of file
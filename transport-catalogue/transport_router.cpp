@@ -1,4 +1,6 @@
 #include "transport_router.h"
+#include "geo.h"
+#include <chrono>
 #include <iostream>
 
 
@@ -11,10 +13,24 @@ namespace router {
 
 
 
-    TransportRouter::TransportRouter(const catalogue::TransportCatalogue& catalogue, int bus_wait_time, int bus_velocity)
-        :bus_wait_time_(bus_wait_time), bus_velocity_(bus_velocity), catalogue_(catalogue)
+    TransportRouter::TransportRouter(const catalogue::TransportCatalogue& catalogue, const RoutingSettings& settings)
+        :bus_wait_time_(settings.bus_wait_time), bus_velocity_(settings.bus_velocity), router_type_(settings.router_type), graph_model_(settings.graph_model), prune_dominated_edges_(settings.prune_dominated_edges), landmark_count_(settings.landmark_count), partition_cell_size_(settings.partition_cell_size), thread_count_(settings.thread_count), cache_file_(settings.cache_file), catalogue_(catalogue), route_cache_(std::max(settings.route_cache_capacity, 0))
     {
-        BuildGraph();
+        connection_scan_ = std::make_unique<ConnectionScan>(catalogue_, km_to_m * bus_velocity_ / h_to_m);
+
+        if (router_type_ == RouterType::RAPTOR) {
+            raptor_ = std::make_unique<Raptor>(catalogue_, bus_wait_time_, km_to_m * bus_velocity_ / h_to_m);
+            return;
+        }
+
+        const uint64_t fingerprint = ComputeFingerprint();
+        if (cache_file_.empty() || !LoadCache(fingerprint)) {
+            BuildGraph();
+            BuildRouter();
+            if (!cache_file_.empty() && !SaveCache(fingerprint)) {
+                std::cerr << "Route cache was not saved to " << cache_file_ << std::endl;
+            }
+        }
     }
 
 
@@ -24,68 +40,821 @@ namespace router {
 
         size_t iter = 0;
         for (const auto& stop : catalogue_.GetStops()) {
-            vertex_by_stop_.insert({ stop, {iter + 1, iter} });
-            stop_by_vertex_.push_back(stop);
-            stop_by_vertex_.push_back(stop);
-            iter += 2;
+            if (graph_model_ == GraphModel::COMPACT) {
+                vertex_by_stop_.push_back({ iter, iter });
+                stop_by_vertex_.push_back(stop);
+                iter += 1;
+            }
+            else {
+                vertex_by_stop_.push_back({ iter + 1, iter });
+                stop_by_vertex_.push_back(stop);
+                stop_by_vertex_.push_back(stop);
+                iter += 2;
+            }
         }
 
-        graph_ = std::make_unique < graph::DirectedWeightedGraph<double>>(vertex_by_stop_.size() * 2);
+        const size_t stop_vertex_count = stop_by_vertex_.size();
 
-        for (size_t i = 0; i < vertex_by_stop_.size() * 2; i += 2) {
-            graph_->AddEdge({ i + 1, i, (double)bus_wait_time_ });
-            route_elem_by_edge_.push_back({ RouteElemType::WAIT, stop_by_vertex_.at(i + 1), stop_by_vertex_.at(i), "", (double)bus_wait_time_, -1 });
+        if (graph_model_ == GraphModel::LINE) {
+            for (const auto& bus : catalogue_.GetBuses()) {
+                for (const StopId stop : catalogue_.GetBusStopIds(bus->id)) {
+                    stop_by_vertex_.push_back(catalogue_.GetStop(stop));
+                }
+            }
         }
 
-        ComputeDistancesAndGenerateEdges();
+        graph_ = std::make_unique < graph::DirectedWeightedGraph<double>>(stop_by_vertex_.size());
+
+        if (graph_model_ != GraphModel::COMPACT) {
+            for (size_t i = 0; i < stop_vertex_count; i += 2) {
+                graph_->AddEdge({ i + 1, i, (double)bus_wait_time_ });
+                route_elem_by_edge_.push_back({ RouteElemType::WAIT, stop_by_vertex_.at(i + 1), stop_by_vertex_.at(i), "", (double)bus_wait_time_, -1 });
+            }
+        }
+
+        if (graph_model_ == GraphModel::LINE) {
+            GenerateLineEdges();
+        }
+        else {
+            ComputeDistancesAndGenerateEdges();
+        }
     }
 
     void TransportRouter::ComputeDistancesAndGenerateEdges() {
 
+        // Buses are independent: blocks are generated in parallel and merged in bus order,
+        // so edge ids do not depend on the thread count
+        const auto buses = catalogue_.GetBuses();
+        std::vector<std::vector<BusEdge>> blocks(buses.size());
+        parallel::ForEachIndex(buses.size(), parallel::ResolveThreadCount(thread_count_), [&](size_t i) {
+            blocks[i] = GenerateBusEdges(buses[i]);
+        });
+
+        size_t edge_count = 0;
+        for (const auto& block : blocks) {
+            edge_count += block.size();
+        }
+
+        std::vector<BusEdge> edges;
+        edges.reserve(edge_count);
+        for (auto& block : blocks) {
+            edges.insert(edges.end(), std::make_move_iterator(block.begin()), std::make_move_iterator(block.end()));
+            block = {};
+        }
+
+        if (prune_dominated_edges_) {
+            PruneDominatedEdges(edges);
+        }
+
+        route_elem_by_edge_.reserve(route_elem_by_edge_.size() + edges.size());
+        for (const auto& bus_edge : edges) {
+            graph_->AddEdge(bus_edge.edge);
+            route_elem_by_edge_.push_back(bus_edge.elem);
+        }
+    }
+
+    std::vector<TransportRouter::BusEdge> TransportRouter::GenerateBusEdges(const Bus* bus) const {
+
+        std::vector<BusEdge> result;
+
+        // Road distance between two positions is a difference of the bus prefix sums
+        const auto prefix = catalogue_.GetBusRoadPrefix(bus->id);
+        const auto stops = catalogue_.GetBusStopIds(bus->id);
+
+        for (size_t from = 0; from < stops.size(); ++from) {
+            for (size_t to = from + 1; to < stops.size(); ++to) {
+                if (stops[from] != stops[to]) {
+
+                    const int total_distance = prefix[to] - prefix[from];
+                    const int total_span = static_cast<int>(to - from);
+                    double time = ComputeTravelTime(total_distance);
+                    double weight = graph_model_ == GraphModel::COMPACT ? bus_wait_time_ + time : time;
+
+                    result.push_back({
+                        { vertex_by_stop_[stops[from]].second, vertex_by_stop_[stops[to]].first, weight },
+                        RouteElem{ RouteElemType::GO, catalogue_.GetStop(stops[from]), catalogue_.GetStop(stops[to]), bus->name, time, total_span, total_distance } });
+                }
+            }
+        }
+        return result;
+    }
+
+    // Keeps one edge per (from, to) vertex pair: the lightest one, then the smallest bus name,
+    // then the shortest span. Surviving edges keep the order of their pair's first appearance.
+    void TransportRouter::PruneDominatedEdges(std::vector<BusEdge>& edges) const {
+
+        auto is_better = [](const BusEdge& lhs, const BusEdge& rhs) {
+            if (lhs.edge.weight != rhs.edge.weight) {
+                return lhs.edge.weight < rhs.edge.weight;
+            }
+            if (lhs.elem.bus_name != rhs.elem.bus_name) {
+                return lhs.elem.bus_name < rhs.elem.bus_name;
+            }
+            return lhs.elem.span_count < rhs.elem.span_count;
+        };
+
+        const size_t vertex_count = stop_by_vertex_.size();
+        std::unordered_map<size_t, size_t> index_by_pair;
+        std::vector<BusEdge> result;
+
+        for (auto& bus_edge : edges) {
+            const auto [iter, inserted] = index_by_pair.insert({ bus_edge.edge.from * vertex_count + bus_edge.edge.to, result.size() });
+            if (inserted) {
+                result.push_back(std::move(bus_edge));
+            }
+            else if (is_better(bus_edge, result[iter->second])) {
+                result[iter->second] = std::move(bus_edge);
+            }
+        }
+        edges = std::move(result);
+    }
+
+    // Riding vertices follow the stop vertices, one per position of every bus in GetBuses() order.
+    // Board and alight edges are zero-weight GO elems with span 0, ride edges cover one span;
+    // ComputeRoute merges each run of GO elems back into a single Bus item.
+    void TransportRouter::GenerateLineEdges() {
+
+        graph::VertexId riding_vertex = vertex_by_stop_.size() * 2;
+
         for (const auto& bus : catalogue_.GetBuses()) {
 
-            for (auto it_from = bus->stops.begin(); it_from != bus->stops.end(); ++it_from) {
+            const auto prefix = catalogue_.GetBusRoadPrefix(bus->id);
+            const auto stops = catalogue_.GetBusStopIds(bus->id);
+            for (size_t i = 0; i < stops.size(); ++i, ++riding_vertex) {
+                const Stop* stop = catalogue_.GetStop(stops[i]);
 
-                int total_distance = 0;
-                int total_span = 0;
+                if (i != 0) {
+                    graph_->AddEdge({ riding_vertex, vertex_by_stop_[stop->id].first, 0 });
+                    route_elem_by_edge_.push_back(RouteElem{ RouteElemType::GO, stop, stop, bus->name, 0, 0 });
+                }
 
-                for (auto it_to = std::next(it_from); it_to != bus->stops.end(); ++it_to) {
-                    int distance = 0;
+                if (i + 1 != stops.size()) {
+                    const Stop* next_stop = catalogue_.GetStop(stops[i + 1]);
 
+                    graph_->AddEdge({ vertex_by_stop_[stop->id].second, riding_vertex, 0 });
+                    route_elem_by_edge_.push_back(RouteElem{ RouteElemType::GO, stop, stop, bus->name, 0, 0 });
 
-                    distance = catalogue_.GetDistanceBetweenStops(*std::prev(it_to), *it_to);
-                    if (distance == -1) {
-                        distance = catalogue_.GetDistanceBetweenStops(*it_to, *std::prev(it_to));
-                    }
+                    const int distance = prefix[i + 1] - prefix[i];
+                    double time = ComputeTravelTime(distance);
 
-                    total_distance += distance;
-                    ++total_span;
-                    if (*it_from != *it_to) {
+                    graph_->AddEdge({ riding_vertex, riding_vertex + 1, time });
+                    route_elem_by_edge_.push_back(RouteElem{ RouteElemType::GO, stop, next_stop, bus->name, time, 1, distance });
+                }
+            }
+        }
+    }
 
-                        double time = total_distance / (km_to_m * bus_velocity_ / h_to_m);
+    double TransportRouter::ComputeTravelTime(int distance) const {
+        return distance / (km_to_m * bus_velocity_ / h_to_m);
+    }
 
-                        graph_->AddEdge({ vertex_by_stop_.at(*it_from).second, vertex_by_stop_.at(*it_to).first, time });
+    // Straight-line distance at bus_velocity is not a lower bound by itself: road distances in
+    // the catalogue may be shorter than the geographic ones. The bound is scaled by the smallest
+    // road / straight-line ratio over all bus segments, so every edge weight stays above it
+    // (waits only add to the weight) and the sum over a route does too, by the triangle inequality.
+    graph::AltRouter<double, graph::CsrGraph<double>>::LowerBound TransportRouter::MakeGeoLowerBound() const {
+        static const double ratio_slack = 0.999;
 
-                        route_elem_by_edge_.push_back(RouteElem{ RouteElemType::GO, (*it_from), (*it_to), bus->name, time, total_span });
-                    }
+        const auto stop_coords = catalogue_.GetStopCoordinates();
+        double ratio = 1.0;
+        for (const auto& bus : catalogue_.GetBuses()) {
+            const auto prefix = catalogue_.GetBusRoadPrefix(bus->id);
+            const auto stops = catalogue_.GetBusStopIds(bus->id);
+            for (size_t i = 1; i < stops.size(); ++i) {
+                const double geo_distance = geo::ComputeDistance(stop_coords[stops[i - 1]], stop_coords[stops[i]]);
+                if (geo_distance > 0) {
+                    ratio = std::min(ratio, (prefix[i] - prefix[i - 1]) / geo_distance);
                 }
             }
         }
-        router_ = std::make_unique<graph::Router<double>>(*graph_);
+        if (ratio <= 0 || bus_velocity_ <= 0) {
+            return {};
+        }
+
+        std::vector<geo::Coordinates> coords_by_vertex;
+        coords_by_vertex.reserve(stop_by_vertex_.size());
+        for (const auto& stop : stop_by_vertex_) {
+            coords_by_vertex.push_back(stop_coords[stop->id]);
+        }
+
+        const double minutes_per_meter = ratio * ratio_slack / (km_to_m * bus_velocity_ / h_to_m);
+        return [coords_by_vertex = std::move(coords_by_vertex), minutes_per_meter](graph::VertexId from, graph::VertexId to) {
+            return geo::ComputeDistance(coords_by_vertex[from], coords_by_vertex[to]) * minutes_per_meter;
+        };
+    }
+
+    // Same weights as edge generation: a Wait edge is the wait, a ride its travel time, and
+    // a COMPACT ride carries the wait too. LINE board and alight edges have no distance.
+    double TransportRouter::ComputeEdgeWeight(const RouteElem& elem) const {
+        if (elem.type == RouteElemType::WAIT) {
+            return bus_wait_time_;
+        }
+        const double time = ComputeTravelTime(elem.distance);
+        return graph_model_ == GraphModel::COMPACT ? bus_wait_time_ + time : time;
+    }
+
+    void TransportRouter::Customize(int bus_wait_time, int bus_velocity) {
+        bus_wait_time_ = bus_wait_time;
+        bus_velocity_ = bus_velocity;
+        route_cache_.Clear();
+        connection_scan_ = std::make_unique<ConnectionScan>(catalogue_, km_to_m * bus_velocity_ / h_to_m);
+
+        if (raptor_) {
+            raptor_->SetCosts(bus_wait_time_, km_to_m * bus_velocity_ / h_to_m);
+            return;
+        }
+
+        for (graph::EdgeId edge_id = 0; edge_id < route_elem_by_edge_.size(); ++edge_id) {
+            RouteElem& elem = route_elem_by_edge_[edge_id];
+            elem.time = elem.type == RouteElemType::WAIT ? bus_wait_time_ : ComputeTravelTime(elem.distance);
+            csr_graph_->SetEdgeWeight(edge_id, ComputeEdgeWeight(elem));
+        }
+
+        // The hierarchy is customized in its own contraction order and the partition keeps its cells;
+        // everything else built on the weights goes, and the all-pairs router also needs the list graph back
+        if (contraction_hierarchy_) {
+            contraction_hierarchy_->Customize(*csr_graph_);
+        }
+        if (partitioned_router_) {
+            partitioned_router_->Customize(*csr_graph_, parallel::ResolveThreadCount(thread_count_));
+        }
+        router_.reset();
+        dijkstra_router_.reset();
+        alt_router_.reset();
+        if (router_type_ == RouterType::ALL_PAIRS) {
+            graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(csr_graph_->GetVertexCount());
+            for (graph::EdgeId edge_id = 0; edge_id < csr_graph_->GetEdgeCount(); ++edge_id) {
+                graph_->AddEdge(csr_graph_->GetEdge(edge_id));
+            }
+        }
+        BuildRouter();
     }
 
-    std::optional<const std::vector<RouteElem>> TransportRouter::ComputeRoute(const std::string_view from, const std::string_view to) {
+    void TransportRouter::AddSearchStats(const graph::SearchStats& stats) const {
+        query_count_.fetch_add(1, std::memory_order_relaxed);
+        settled_vertices_.fetch_add(stats.settled_vertices, std::memory_order_relaxed);
+    }
+
+    void TransportRouter::RecordQuery(const QueryStats& stats) const {
+        query_recorder_.query_count.fetch_add(1, std::memory_order_relaxed);
+        query_recorder_.settled_vertices.Add(static_cast<double>(stats.search.settled_vertices));
+        query_recorder_.relaxed_edges.Add(static_cast<double>(stats.search.relaxed_edges));
+        query_recorder_.heap_pushes.Add(static_cast<double>(stats.search.heap_pushes));
+        query_recorder_.heap_pops.Add(static_cast<double>(stats.search.heap_pops));
+        query_recorder_.wall_time_us.Add(stats.wall_time_us);
+    }
+
+    QueryHistograms TransportRouter::GetQueryHistograms() const {
+        return { query_recorder_.query_count.load(),
+            query_recorder_.settled_vertices.GetBuckets(), query_recorder_.relaxed_edges.GetBuckets(),
+            query_recorder_.heap_pushes.GetBuckets(), query_recorder_.heap_pops.GetBuckets(),
+            query_recorder_.wall_time_us.GetBuckets() };
+    }
+
+    SearchTotals TransportRouter::GetSearchTotals() const {
+        return { query_count_.load(), settled_vertices_.load() };
+    }
+
+    // The edge lists are frozen into CSR once generation is done; only the all-pairs router
+    // still needs the DirectedWeightedGraph, the other routers walk the CSR copy.
+    void TransportRouter::BuildRouter() {
+        if (!csr_graph_) {
+            csr_graph_ = std::make_unique<graph::CsrGraph<double>>(*graph_);
+        }
+
+        // Needs no preprocessing, so it is kept for isochrones whatever the router type
+        dijkstra_router_ = std::make_unique<graph::DijkstraRouter<double, graph::CsrGraph<double>>>(*csr_graph_);
+
+        if (router_type_ == RouterType::DIJKSTRA) {
+            // Routes are answered by the Dijkstra router above; nothing to preprocess
+        }
+        else if (router_type_ == RouterType::CONTRACTION_HIERARCHIES && !contraction_hierarchy_) {
+            contraction_hierarchy_ = std::make_unique<ContractionHierarchy>(*csr_graph_, parallel::ResolveThreadCount(thread_count_));
+        }
+        else if (router_type_ == RouterType::ALT) {
+            alt_router_ = std::make_unique<graph::AltRouter<double, graph::CsrGraph<double>>>(*csr_graph_, std::max(landmark_count_, 0), parallel::ResolveThreadCount(thread_count_), MakeGeoLowerBound());
+        }
+        else if (router_type_ == RouterType::PARTITIONED && !partitioned_router_) {
+            partitioned_router_ = std::make_unique<PartitionedRouter>(*csr_graph_, PartitionVertices(), parallel::ResolveThreadCount(thread_count_));
+        }
+        else if (router_type_ == RouterType::ALL_PAIRS && !router_) {
+            router_ = std::make_unique<graph::AllPairsRouter<double>>(*graph_, parallel::ResolveThreadCount(thread_count_));
+        }
+
+        if (router_type_ != RouterType::ALL_PAIRS) {
+            graph_.reset();
+        }
+    }
+
+    namespace {
+
+        const uint32_t NO_ID = static_cast<uint32_t>(-1);
+
+        struct VertexPairRecord {
+            uint64_t first;
+            uint64_t second;
+        };
+
+        struct RouteElemRecord {
+            uint32_t type;
+            uint32_t from;
+            uint32_t to;
+            uint32_t bus;
+            double time;
+            int32_t span_count;
+            int32_t distance;
+        };
+
+        uint32_t FindId(const Stop* stop) {
+            if (stop == nullptr) {
+                return NO_ID;
+            }
+            return stop->id;
+        }
+
+    }
+
+    // Covers everything the graph and the tables are built from: stops, buses,
+    // the road distances between their consecutive stops and the routing settings
+    uint64_t TransportRouter::ComputeFingerprint() const {
+        serialization::Hasher hasher;
+        hasher.Add(serialization::VERSION);
+        hasher.Add(bus_wait_time_);
+        hasher.Add(bus_velocity_);
+        hasher.Add(router_type_);
+        hasher.Add(graph_model_);
+        hasher.Add(prune_dominated_edges_);
+        hasher.Add(partition_cell_size_);
+
+        const auto stop_coords = catalogue_.GetStopCoordinates();
+        for (const auto& stop : catalogue_.GetStops()) {
+            hasher.Add(stop->name);
+            hasher.Add(stop_coords[stop->id].lat);
+            hasher.Add(stop_coords[stop->id].lng);
+        }
+
+        for (const auto& bus : catalogue_.GetBuses()) {
+            hasher.Add(bus->name);
+            hasher.Add(bus->is_roundtrip);
+            const auto stops = catalogue_.GetBusStopIds(bus->id);
+            hasher.Add(static_cast<uint64_t>(stops.size()));
+            for (size_t i = 0; i < stops.size(); ++i) {
+                hasher.Add(stops[i]);
+                if (i != 0) {
+                    hasher.Add(catalogue_.GetDistanceBetweenStops(stops[i - 1], stops[i]));
+                    hasher.Add(catalogue_.GetDistanceBetweenStops(stops[i], stops[i - 1]));
+                }
+            }
+        }
+        return hasher.GetHash();
+    }
+
+    // Sections: stop id per vertex, vertex pair per stop, graph edges, route elems, all-pairs table
+    bool TransportRouter::SaveCache(uint64_t fingerprint) const {
+        const auto buses = catalogue_.GetBuses();
+
+        std::unordered_map<std::string_view, uint32_t> bus_ids;
+        for (const auto& bus : buses) {
+            bus_ids.insert({ bus->name, static_cast<uint32_t>(bus_ids.size()) });
+        }
+
+        std::vector<uint32_t> stop_by_vertex;
+        stop_by_vertex.reserve(stop_by_vertex_.size());
+        for (const auto& stop : stop_by_vertex_) {
+            stop_by_vertex.push_back(FindId(stop));
+        }
+
+        std::vector<VertexPairRecord> vertex_by_stop;
+        vertex_by_stop.reserve(vertex_by_stop_.size());
+        for (const auto& vertices : vertex_by_stop_) {
+            vertex_by_stop.push_back({ vertices.first, vertices.second });
+        }
+
+        std::vector<graph::Edge<double>> edges;
+        edges.reserve(csr_graph_->GetEdgeCount());
+        for (graph::EdgeId edge_id = 0; edge_id < csr_graph_->GetEdgeCount(); ++edge_id) {
+            edges.push_back(csr_graph_->GetEdge(edge_id));
+        }
+
+        std::vector<RouteElemRecord> elems;
+        elems.reserve(route_elem_by_edge_.size());
+        for (const auto& elem : route_elem_by_edge_) {
+            elems.push_back({ static_cast<uint32_t>(elem.type), FindId(elem.from), FindId(elem.to),
+                elem.type == RouteElemType::GO ? bus_ids.at(elem.bus_name) : NO_ID,
+                elem.time, elem.span_count, elem.distance });
+        }
+
+        serialization::Writer writer(cache_file_, fingerprint);
+        writer.WriteSection(stop_by_vertex);
+        writer.WriteSection(vertex_by_stop);
+        writer.WriteSection(edges);
+        writer.WriteSection(elems);
+        writer.WriteSection(router_ ? router_->GetRoutesInternalData() : std::vector<graph::AllPairsRouter<double>::RouteInternalData>{});
+        if (!writer.Finish()) {
+            return false;
+        }
+
+        if (partitioned_router_ && !SavePartition(fingerprint)) {
+            return false;
+        }
+        if (contraction_hierarchy_ && !SaveHierarchy(fingerprint)) {
+            return false;
+        }
+        return true;
+    }
+
+    bool TransportRouter::LoadCache(uint64_t fingerprint) {
+        serialization::Reader reader(cache_file_, fingerprint);
+        if (!reader.IsValid()) {
+            return false;
+        }
+
+        std::vector<uint32_t> stop_by_vertex;
+        std::vector<VertexPairRecord> vertex_by_stop;
+        std::vector<graph::Edge<double>> edges;
+        std::vector<RouteElemRecord> elems;
+        std::vector<graph::AllPairsRouter<double>::RouteInternalData> routes_internal_data;
+
+        if (!reader.ReadSection(stop_by_vertex) || !reader.ReadSection(vertex_by_stop) || !reader.ReadSection(edges)
+            || !reader.ReadSection(elems) || !reader.ReadSection(routes_internal_data) || !reader.Finish()) {
+            return false;
+        }
+
+        const auto stops = catalogue_.GetStops();
+        const auto buses = catalogue_.GetBuses();
+        if (vertex_by_stop.size() != stops.size() || elems.size() != edges.size()) {
+            return false;
+        }
+
+        for (const uint32_t stop_id : stop_by_vertex) {
+            stop_by_vertex_.push_back(stops.at(stop_id));
+        }
+        for (const auto& vertices : vertex_by_stop) {
+            vertex_by_stop_.push_back({ vertices.first, vertices.second });
+        }
+
+        graph_ = std::make_unique<graph::DirectedWeightedGraph<double>>(stop_by_vertex_.size());
+        for (const auto& edge : edges) {
+            graph_->AddEdge(edge);
+        }
+
+        route_elem_by_edge_.reserve(elems.size());
+        for (const auto& elem : elems) {
+            route_elem_by_edge_.push_back({ static_cast<RouteElemType>(elem.type),
+                elem.from == NO_ID ? nullptr : stops.at(elem.from),
+                elem.to == NO_ID ? nullptr : stops.at(elem.to),
+                elem.bus == NO_ID ? std::string_view() : std::string_view(buses.at(elem.bus)->name),
+                elem.time, elem.span_count, elem.distance });
+        }
+
+        if (router_type_ == RouterType::ALL_PAIRS) {
+            router_ = std::make_unique<graph::AllPairsRouter<double>>(*graph_, std::move(routes_internal_data));
+        }
+        // A missing or stale overlay or hierarchy is rebuilt from the loaded graph and saved again
+        const bool rebuild_partition = router_type_ == RouterType::PARTITIONED && !LoadPartition(fingerprint);
+        const bool rebuild_hierarchy = router_type_ == RouterType::CONTRACTION_HIERARCHIES && !LoadHierarchy(fingerprint);
+        BuildRouter();
+        if ((rebuild_partition && !SavePartition(fingerprint)) || (rebuild_hierarchy && !SaveHierarchy(fingerprint))) {
+            std::cerr << "Route cache was not saved to " << cache_file_ << std::endl;
+        }
+        return true;
+    }
+
+    // Every vertex belongs to the cell of its stop
+    std::vector<uint32_t> TransportRouter::PartitionVertices() const {
+        const auto coords = catalogue_.GetStopCoordinates();
+        const std::vector<uint32_t> cell_by_stop = geo::PartitionByCoordinates({ coords.begin(), coords.end() }, static_cast<size_t>(std::max(partition_cell_size_, 1)));
+        std::vector<uint32_t> cell_by_vertex;
+        cell_by_vertex.reserve(stop_by_vertex_.size());
+        for (const auto& stop : stop_by_vertex_) {
+            cell_by_vertex.push_back(cell_by_stop[stop->id]);
+        }
+        return cell_by_vertex;
+    }
+
+    std::string TransportRouter::GetCellFile(size_t cell) const {
+        return cache_file_ + ".cell" + std::to_string(cell);
+    }
+
+    // One file per cell: cell vertices, edge offsets, edges; then the overlay file next to the
+    // cache file, written last so that an overlay on disk always comes with its cells
+    bool TransportRouter::SavePartition(uint64_t fingerprint) const {
+        for (size_t cell_id = 0; cell_id < partitioned_router_->GetCellCount(); ++cell_id) {
+            const auto cell = partitioned_router_->GetCell(cell_id);
+            serialization::Writer cell_writer(GetCellFile(cell_id), fingerprint);
+            cell_writer.WriteSection(cell->vertices);
+            cell_writer.WriteSection(cell->offsets);
+            cell_writer.WriteSection(cell->edges);
+            if (!cell_writer.Finish()) {
+                return false;
+            }
+        }
+
+        const auto& overlay = partitioned_router_->GetOverlay();
+        serialization::Writer writer(cache_file_ + ".overlay", fingerprint);
+        writer.WriteSection(overlay.cell_by_vertex);
+        writer.WriteSection(overlay.local_by_vertex);
+        writer.WriteSection(overlay.entry_offsets);
+        writer.WriteSection(overlay.entry_vertices);
+        writer.WriteSection(overlay.exit_offsets);
+        writer.WriteSection(overlay.exit_vertices);
+        writer.WriteSection(overlay.clique_offsets);
+        writer.WriteSection(overlay.clique_weights);
+        writer.WriteSection(overlay.cut_offsets);
+        writer.WriteSection(overlay.cut_edges);
+        return writer.Finish();
+    }
+
+    // Only the overlay is read here; cells are read on first use
+    bool TransportRouter::LoadPartition(uint64_t fingerprint) {
+        serialization::Reader reader(cache_file_ + ".overlay", fingerprint);
+        if (!reader.IsValid()) {
+            return false;
+        }
+
+        PartitionedRouter::Overlay overlay;
+        if (!reader.ReadSection(overlay.cell_by_vertex) || !reader.ReadSection(overlay.local_by_vertex)
+            || !reader.ReadSection(overlay.entry_offsets) || !reader.ReadSection(overlay.entry_vertices)
+            || !reader.ReadSection(overlay.exit_offsets) || !reader.ReadSection(overlay.exit_vertices)
+            || !reader.ReadSection(overlay.clique_offsets) || !reader.ReadSection(overlay.clique_weights)
+            || !reader.ReadSection(overlay.cut_offsets) || !reader.ReadSection(overlay.cut_edges) || !reader.Finish()) {
+            return false;
+        }
+        if (overlay.cell_by_vertex.size() != stop_by_vertex_.size() || overlay.entry_offsets.size() != overlay.exit_offsets.size() || overlay.entry_offsets.empty()) {
+            return false;
+        }
+
+        partitioned_router_ = std::make_unique<PartitionedRouter>(std::move(overlay), [this, fingerprint](size_t cell) {
+            return LoadCell(cell, fingerprint);
+        });
+        return true;
+    }
+
+    // A missing or stale cell file is rebuilt from the graph, which the overlay was made from
+    TransportRouter::PartitionedRouter::Cell TransportRouter::LoadCell(size_t cell_id, uint64_t fingerprint) const {
+        serialization::Reader reader(GetCellFile(cell_id), fingerprint);
+        PartitionedRouter::Cell cell;
+        if (reader.IsValid() && reader.ReadSection(cell.vertices) && reader.ReadSection(cell.offsets)
+            && reader.ReadSection(cell.edges) && reader.Finish() && cell.offsets.size() == cell.vertices.size() + 1) {
+            return cell;
+        }
+
+        const auto& cell_by_vertex = partitioned_router_->GetOverlay().cell_by_vertex;
+        std::vector<graph::VertexId> vertices;
+        for (graph::VertexId vertex = 0; vertex < cell_by_vertex.size(); ++vertex) {
+            if (cell_by_vertex[vertex] == cell_id) {
+                vertices.push_back(vertex);
+            }
+        }
+        return PartitionedRouter::MakeCell(*csr_graph_, vertices);
+    }
+
+    // Hierarchy file next to the cache file: shortcuts, contraction rounds, upward links.
+    // The graph edges, the first arcs of the hierarchy, come from the main cache file.
+    bool TransportRouter::SaveHierarchy(uint64_t fingerprint) const {
+        const auto data = contraction_hierarchy_->GetData();
+        serialization::Writer writer(cache_file_ + ".ch", fingerprint);
+        writer.WriteSection(data.shortcuts);
+        writer.WriteSection(data.round_offsets);
+        writer.WriteSection(data.round_vertices);
+        writer.WriteSection(data.upward_out_offsets);
+        writer.WriteSection(data.upward_out_links);
+        writer.WriteSection(data.upward_in_offsets);
+        writer.WriteSection(data.upward_in_links);
+        return writer.Finish();
+    }
+
+    bool TransportRouter::LoadHierarchy(uint64_t fingerprint) {
+        serialization::Reader reader(cache_file_ + ".ch", fingerprint);
+        if (!reader.IsValid()) {
+            return false;
+        }
+
+        ContractionHierarchy::Data data;
+        if (!reader.ReadSection(data.shortcuts) || !reader.ReadSection(data.round_offsets) || !reader.ReadSection(data.round_vertices)
+            || !reader.ReadSection(data.upward_out_offsets) || !reader.ReadSection(data.upward_out_links)
+            || !reader.ReadSection(data.upward_in_offsets) || !reader.ReadSection(data.upward_in_links) || !reader.Finish()) {
+            return false;
+        }
+
+        if (!csr_graph_) {
+            csr_graph_ = std::make_unique<graph::CsrGraph<double>>(*graph_);
+        }
+        try {
+            contraction_hierarchy_ = std::make_unique<ContractionHierarchy>(*csr_graph_, std::move(data), parallel::ResolveThreadCount(thread_count_));
+        }
+        catch (const std::invalid_argument&) {
+            return false;
+        }
+        return true;
+    }
+
+    namespace {
+
+        uint64_t MakeRouteKey(graph::VertexId from, graph::VertexId to) {
+            return static_cast<uint64_t>(from) << 32 | static_cast<uint64_t>(to);
+        }
+
+        std::optional<std::vector<uint32_t>> CompactRouteEdges(const std::optional<std::vector<graph::EdgeId>>& edges) {
+            if (!edges.has_value()) {
+                return std::nullopt;
+            }
+            return std::vector<uint32_t>(edges.value().begin(), edges.value().end());
+        }
+
+        std::optional<std::vector<graph::EdgeId>> ExpandRouteEdges(const std::optional<std::vector<uint32_t>>& edges) {
+            if (!edges.has_value()) {
+                return std::nullopt;
+            }
+            return std::vector<graph::EdgeId>(edges.value().begin(), edges.value().end());
+        }
+
+    }
+
+    cache::CacheStats TransportRouter::GetRouteCacheStats() const {
+        return route_cache_.GetStats();
+    }
+
+    std::optional<std::vector<graph::EdgeId>> TransportRouter::BuildRouteEdges(graph::VertexId from, graph::VertexId to, QueryStats* query_stats) const {
+        ROUTER_INSTRUMENT(const auto start = std::chrono::steady_clock::now();)
+        QueryStats stats;
+        std::optional<std::vector<graph::EdgeId>> route;
+
+        const uint64_t key = MakeRouteKey(from, to);
+        if (auto cached = route_cache_.Get(key)) {
+            stats.cache_hit = true;
+            route = ExpandRouteEdges(cached.value());
+        }
+        else {
+            route = SearchRouteEdges(from, to, stats.search);
+            route_cache_.Put(key, CompactRouteEdges(route));
+        }
+
+        ROUTER_INSTRUMENT(
+            stats.wall_time_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            RecordQuery(stats);
+        )
+        if (query_stats != nullptr) {
+            *query_stats = stats;
+        }
+        return route;
+    }
+
+    std::optional<std::vector<graph::EdgeId>> TransportRouter::SearchRouteEdges(graph::VertexId from, graph::VertexId to, graph::SearchStats& stats) const {
+        if (router_type_ == RouterType::DIJKSTRA) {
+            auto route = dijkstra_router_->BuildRoute(from, to, &stats);
+            AddSearchStats(stats);
+            if (!route.has_value()) {
+                return std::nullopt;
+            }
+            return std::move(route.value().edges);
+        }
+        if (router_type_ == RouterType::ALT) {
+            auto route = alt_router_->BuildRoute(from, to, &stats);
+            AddSearchStats(stats);
+            if (!route.has_value()) {
+                return std::nullopt;
+            }
+            return std::move(route.value().edges);
+        }
+        if (router_type_ == RouterType::PARTITIONED) {
+            auto route = partitioned_router_->BuildRoute(from, to, &stats);
+            AddSearchStats(stats);
+            if (!route.has_value()) {
+                return std::nullopt;
+            }
+            return std::move(route.value().edges);
+        }
+        if (router_type_ == RouterType::CONTRACTION_HIERARCHIES) {
+            auto route = contraction_hierarchy_->BuildRoute(from, to, &stats);
+            AddSearchStats(stats);
+            if (!route.has_value()) {
+                return std::nullopt;
+            }
+            return std::move(route.value().edges);
+        }
+
+        auto route = router_->BuildRoute(from, to);
+        if (!route.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(route.value().edges);
+    }
+
+    // Dijkstra settles all targets of an origin in one search; the all-pairs table, the
+    // contraction hierarchy and A* answer each target directly, which is already cheaper than a full tree
+    std::vector<std::optional<std::vector<graph::EdgeId>>> TransportRouter::BuildRouteEdgesFrom(graph::VertexId from, const std::vector<graph::VertexId>& targets) const {
+        std::vector<std::optional<std::vector<graph::EdgeId>>> result;
+        result.reserve(targets.size());
+
+        if (router_type_ == RouterType::DIJKSTRA) {
+            // Only the targets missing from the cache are searched for
+            std::vector<graph::VertexId> missing_targets;
+            std::vector<size_t> missing_indices;
+            for (size_t i = 0; i < targets.size(); ++i) {
+                if (auto cached = route_cache_.Get(MakeRouteKey(from, targets[i]))) {
+                    result.push_back(ExpandRouteEdges(cached.value()));
+                    ROUTER_INSTRUMENT(RecordQuery({ {}, true, 0 });)
+                }
+                else {
+                    result.push_back(std::nullopt);
+                    missing_targets.push_back(targets[i]);
+                    missing_indices.push_back(i);
+                }
+            }
+            if (missing_targets.empty()) {
+                return result;
+            }
+
+            ROUTER_INSTRUMENT(const auto start = std::chrono::steady_clock::now();)
+            graph::SearchStats stats;
+            auto routes = dijkstra_router_->BuildRoutes(from, missing_targets, &stats);
+            for (size_t i = 0; i < routes.size(); ++i) {
+                auto& route = result[missing_indices[i]];
+                if (routes[i].has_value()) {
+                    route = std::move(routes[i].value().edges);
+                }
+                route_cache_.Put(MakeRouteKey(from, missing_targets[i]), CompactRouteEdges(route));
+            }
+            AddSearchStats(stats);
+            ROUTER_INSTRUMENT(RecordQuery({ stats, false, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() });)
+            return result;
+        }
+
+        for (const auto to : targets) {
+            result.push_back(BuildRouteEdges(from, to));
+        }
+        return result;
+    }
+
+    std::vector<RouteElem> TransportRouter::BuildRouteElems(const std::vector<graph::EdgeId>& edges) const {
+        std::vector<RouteElem> result;
+
+        for (const auto edge : edges) {
+            const RouteElem& elem = route_elem_by_edge_.at(edge);
+
+            if (graph_model_ == GraphModel::COMPACT) {
+                result.push_back({ RouteElemType::WAIT, elem.from, elem.from, "", (double)bus_wait_time_, -1 });
+            }
+
+            if (elem.type == RouteElemType::GO && !result.empty() && result.back().type == RouteElemType::GO) {
+                result.back().to = elem.to;
+                result.back().span_count += elem.span_count;
+                result.back().distance += elem.distance;
+                result.back().time = ComputeTravelTime(result.back().distance);
+            }
+            else {
+                result.push_back(elem);
+            }
+        }
+        return result;
+    }
+
+    std::vector<RouteElem> TransportRouter::BuildJourneyElems(const Journey& journey) const {
+        std::vector<RouteElem> result;
+        result.reserve(journey.size() * 2);
+
+        for (const auto& leg : journey) {
+            const auto stops = catalogue_.GetBusStopIds(leg.bus->id);
+            const Stop* board = catalogue_.GetStop(stops[leg.board]);
+            const Stop* alight = catalogue_.GetStop(stops[leg.alight]);
+            result.push_back({ RouteElemType::WAIT, board, board, "", (double)bus_wait_time_, -1 });
+            result.push_back({ RouteElemType::GO, board, alight, leg.bus->name, ComputeTravelTime(leg.distance), static_cast<int>(leg.alight - leg.board), leg.distance });
+        }
+        return result;
+    }
+
+    std::optional<const std::vector<RouteElem>> TransportRouter::ComputeRoute(const std::string_view from, const std::string_view to, QueryStats* query_stats) {
 
         std::vector<RouteElem> result;
 
+        const Stop* from_stop = catalogue_.FindStopByName(from);
+        const Stop* to_stop = catalogue_.FindStopByName(to);
+        if (from != to && (from_stop == nullptr || to_stop == nullptr)) {
+            return std::nullopt;
+        }
+
+        if (from != to && raptor_) {
+            ROUTER_INSTRUMENT(const auto start = std::chrono::steady_clock::now();)
+            const auto journey = raptor_->ComputeJourney(from_stop, to_stop);
+            ROUTER_INSTRUMENT(
+                QueryStats stats{ {}, false, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() };
+                RecordQuery(stats);
+                if (query_stats != nullptr) {
+                    *query_stats = stats;
+                }
+            )
+            if (!journey.has_value()) {
+                return std::nullopt;
+            }
+            return BuildJourneyElems(journey.value());
+        }
+
         if (from != to) {
-            const auto route = router_->BuildRoute(vertex_by_stop_.at(catalogue_.FindStopByName(from)).first, vertex_by_stop_.at(catalogue_.FindStopByName(to)).first);
+            const auto route = BuildRouteEdges(vertex_by_stop_[from_stop->id].first, vertex_by_stop_[to_stop->id].first, query_stats);
 
             if (route.has_value()) {
-                for (const auto edge : route.value().edges) {
-                    result.push_back(route_elem_by_edge_.at(edge));
-                }
-                return result;
+                return BuildRouteElems(route.value());
             }
             else {
                 return std::nullopt;
@@ -95,4 +864,181 @@ namespace router {
             return result;
         }
     }
+
+    std::optional<std::vector<RouteElem>> TransportRouter::ComputeRoute(const std::string_view from, const std::string_view to, double departure_time) const {
+        std::vector<RouteElem> result;
+        if (from == to) {
+            return result;
+        }
+
+        const Stop* from_stop = catalogue_.FindStopByName(from);
+        const Stop* to_stop = catalogue_.FindStopByName(to);
+        if (from_stop == nullptr || to_stop == nullptr) {
+            return std::nullopt;
+        }
+
+        const auto journey = connection_scan_->ComputeJourney(from_stop, to_stop, departure_time);
+        if (!journey.has_value()) {
+            return std::nullopt;
+        }
+
+        double time = departure_time;
+        for (const auto& leg : journey.value()) {
+            const auto stops = catalogue_.GetBusStopIds(leg.bus->id);
+            const Stop* board = catalogue_.GetStop(stops[leg.board]);
+            const Stop* alight = catalogue_.GetStop(stops[leg.alight]);
+            result.push_back({ RouteElemType::WAIT, board, board, "", leg.departure - time, -1 });
+            result.push_back({ RouteElemType::GO, board, alight, leg.bus->name, leg.arrival - leg.departure, static_cast<int>(leg.alight - leg.board), leg.distance });
+            time = leg.arrival;
+        }
+        return result;
+    }
+
+    std::optional<std::vector<IsochroneElem>> TransportRouter::ComputeIsochrone(const std::string_view from, double max_time) const {
+        const Stop* from_stop = catalogue_.FindStopByName(from);
+        if (from_stop == nullptr) {
+            return std::nullopt;
+        }
+
+        std::vector<IsochroneElem> result;
+        if (raptor_) {
+            for (const auto& [stop, time] : raptor_->ComputeReachableStops(from_stop, max_time)) {
+                result.push_back({ stop, time });
+            }
+        }
+        else {
+            // Arrival vertices are settled once per stop; boarding and riding vertices are skipped
+            graph::SearchStats stats;
+            dijkstra_router_->ForEachReachableVertex(vertex_by_stop_[from_stop->id].first, max_time, [&](graph::VertexId vertex, double time) {
+                const Stop* stop = stop_by_vertex_[vertex];
+                if (vertex_by_stop_[stop->id].first == vertex) {
+                    result.push_back({ stop, time });
+                }
+            }, &stats);
+            AddSearchStats(stats);
+        }
+
+        std::sort(result.begin(), result.end(), [](const IsochroneElem& lhs, const IsochroneElem& rhs) {
+            return lhs.time < rhs.time || (lhs.time == rhs.time && lhs.stop->name < rhs.stop->name);
+        });
+        return result;
+    }
+
+    std::optional<TravelTimeMatrix> TransportRouter::ComputeMatrix(const std::vector<std::string_view>& sources, const std::vector<std::string_view>& targets) const {
+        auto find_stops = [&](const std::vector<std::string_view>& names, std::vector<const Stop*>& stops) {
+            stops.reserve(names.size());
+            for (const auto& name : names) {
+                const Stop* stop = catalogue_.FindStopByName(name);
+                if (stop == nullptr) {
+                    return false;
+                }
+                stops.push_back(stop);
+            }
+            return true;
+        };
+
+        std::vector<const Stop*> source_stops;
+        std::vector<const Stop*> target_stops;
+        if (!find_stops(sources, source_stops) || !find_stops(targets, target_stops)) {
+            return std::nullopt;
+        }
+
+        std::vector<graph::VertexId> target_vertices;
+        if (!raptor_) {
+            target_vertices.reserve(target_stops.size());
+            for (const auto& stop : target_stops) {
+                target_vertices.push_back(vertex_by_stop_[stop->id].first);
+            }
+        }
+
+        // The all-pairs table answers directly; other graph routers share one Dijkstra per row
+        TravelTimeMatrix result(source_stops.size());
+        parallel::ForEachIndex(source_stops.size(), parallel::ResolveThreadCount(thread_count_), [&](size_t row) {
+            if (raptor_) {
+                result[row] = raptor_->ComputeTravelTimes(source_stops[row], target_stops);
+                return;
+            }
+
+            const graph::VertexId from = vertex_by_stop_[source_stops[row]->id].first;
+            if (router_type_ == RouterType::ALL_PAIRS) {
+                result[row].reserve(target_vertices.size());
+                for (const auto to : target_vertices) {
+                    result[row].push_back(router_->GetWeight(from, to));
+                }
+                return;
+            }
+
+            graph::SearchStats stats;
+            result[row] = dijkstra_router_->ComputeWeights(from, target_vertices, &stats);
+            AddSearchStats(stats);
+        });
+
+        return result;
+    }
+
+    std::vector<std::optional<std::vector<RouteElem>>> TransportRouter::ComputeRoutes(const std::vector<RouteRequest>& requests) const {
+        struct OriginGroup {
+            const Stop* from;
+            std::vector<const Stop*> targets;
+            std::vector<size_t> request_indices;
+        };
+
+        std::vector<std::optional<std::vector<RouteElem>>> result(requests.size());
+
+        std::vector<OriginGroup> groups;
+        std::unordered_map<std::string_view, size_t> group_by_origin;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const auto& [from, to] = requests[i];
+            if (from == to) {
+                result[i] = std::vector<RouteElem>{};
+                continue;
+            }
+
+            const Stop* from_stop = catalogue_.FindStopByName(from);
+            const Stop* to_stop = catalogue_.FindStopByName(to);
+            if (from_stop == nullptr || to_stop == nullptr) {
+                result[i] = std::nullopt;
+                continue;
+            }
+
+            const auto [it, inserted] = group_by_origin.insert({ from, groups.size() });
+            if (inserted) {
+                groups.push_back({ from_stop, {}, {} });
+            }
+            auto& group = groups[it->second];
+            group.targets.push_back(to_stop);
+            group.request_indices.push_back(i);
+        }
+
+        parallel::ForEachIndex(groups.size(), parallel::ResolveThreadCount(thread_count_), [&](size_t group_index) {
+            const auto& group = groups[group_index];
+
+            if (raptor_) {
+                ROUTER_INSTRUMENT(const auto start = std::chrono::steady_clock::now();)
+                const auto journeys = raptor_->ComputeJourneys(group.from, group.targets);
+                ROUTER_INSTRUMENT(RecordQuery({ {}, false, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() });)
+                for (size_t i = 0; i < journeys.size(); ++i) {
+                    if (journeys[i].has_value()) {
+                        result[group.request_indices[i]] = BuildJourneyElems(journeys[i].value());
+                    }
+                }
+                return;
+            }
+
+            std::vector<graph::VertexId> targets;
+            targets.reserve(group.targets.size());
+            for (const auto& target : group.targets) {
+                targets.push_back(vertex_by_stop_[target->id].first);
+            }
+
+            auto routes = BuildRouteEdgesFrom(vertex_by_stop_[group.from->id].first, targets);
+            for (size_t i = 0; i < routes.size(); ++i) {
+                if (routes[i].has_value()) {
+                    result[group.request_indices[i]] = BuildRouteElems(routes[i].value());
+                }
+            }
+        });
+
+        return result;
+    }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <unordered_map>
 #include <vector>
@@ -7,11 +8,23 @@
 
 #include "domain.h"
 #include "transport_catalogue.h"
-#include "router.h"
+#include "all_pairs_router.h"
+#include "alt_router.h"
+#include "connection_scan.h"
+#include "csr_graph.h"
+#include "dijkstra_router.h"
+#include "contraction_hierarchies.h"
+#include "instrumentation.h"
+#include "lru_cache.h"
+#include "parallel.h"
+#include "partitioned_router.h"
+#include "raptor.h"
+#include "serialization.h"
 
 namespace router {
 
-    using VertexByStop = std::unordered_map<const Stop*, std::pair<size_t, size_t>>;
+    // (arrival, boarding) vertices of every stop, indexed by StopId
+    using VertexByStop = std::vector<std::pair<size_t, size_t>>;
     using StopByVertex = std::vector<const Stop*>;
 
     enum RouteElemType {
@@ -26,20 +39,171 @@ namespace router {
         std::string_view bus_name;
         double time;
         int span_count;
+        int distance = 0;
     };
 
     using RouteElemByEdge = std::vector<RouteElem>;
 
+    // Stop names of a Route request: from, to
+    using RouteRequest = std::pair<std::string_view, std::string_view>;
+
+    // Row per source, column per target; std::nullopt where the target is unreachable
+    using TravelTimeMatrix = std::vector<std::vector<std::optional<double>>>;
+
+    // Stop of an isochrone and the shortest travel time to it
+    struct IsochroneElem {
+        const Stop* stop;
+        double time;
+    };
+
+    enum RouterType {
+        ALL_PAIRS,
+        DIJKSTRA,
+        CONTRACTION_HIERARCHIES,
+        ALT,
+        // Round-based search over the buses themselves; no graph is built
+        RAPTOR,
+        // Stops split into geographic cells; queries search the end cells and the overlay of cell boundaries
+        PARTITIONED
+    };
+
+    // STOP_PAIRS: an edge from every stop of a bus to every later stop of the same bus.
+    // LINE: a riding vertex per bus stop position with board/ride/alight edges, O(n) edges per bus.
+    // COMPACT: STOP_PAIRS with one vertex per stop; bus_wait_time is carried on every GO edge
+    // and the Wait items are synthesized when the route is rebuilt.
+    enum GraphModel {
+        STOP_PAIRS,
+        LINE,
+        COMPACT
+    };
+
+    struct RoutingSettings {
+        int bus_wait_time = 0;
+        int bus_velocity = 0;
+        RouterType router_type = RouterType::ALL_PAIRS;
+        GraphModel graph_model = GraphModel::STOP_PAIRS;
+        bool prune_dominated_edges = false;
+        // When set, the built graph is saved here and reused on the next start if the catalogue
+        // and these settings are unchanged, together with the all-pairs table, the contraction
+        // hierarchy or the partition overlay of the router type. ALT landmarks are recomputed.
+        std::string cache_file;
+        // Routes kept in the edge-list cache of the graph routers; 0 disables it
+        int route_cache_capacity = 0;
+        // Landmarks of the ALT router; each costs two weights per graph vertex
+        int landmark_count = 8;
+        // Most stops in one cell of the partitioned router. With a cache file, every cell is
+        // saved to a file of its own and read when a query first needs it. This only shortens
+        // start-up: the whole graph and its route elements are loaded as well, for unpacking
+        // routes, isochrones, matrices and Customize.
+        int partition_cell_size = 256;
+        int thread_count = 0;
+    };
+
+    // Totals over the queries answered by a graph search (every graph router but all-pairs)
+    struct SearchTotals {
+        size_t query_count = 0;
+        size_t settled_vertices = 0;
+    };
+
+    // Counters of one route query. Besides settled vertices and the cache hit they are recorded
+    // only in builds with TRANSPORT_ROUTER_INSTRUMENTATION; RAPTOR queries carry the time alone.
+    struct QueryStats {
+        graph::SearchStats search;
+        bool cache_hit = false;
+        double wall_time_us = 0;
+    };
+
+    // Route queries of the run in power-of-two buckets (instrumentation::Histogram::GetBuckets);
+    // empty unless built with TRANSPORT_ROUTER_INSTRUMENTATION. A batched search shared by
+    // several targets counts once.
+    struct QueryHistograms {
+        size_t query_count = 0;
+        std::vector<size_t> settled_vertices;
+        std::vector<size_t> relaxed_edges;
+        std::vector<size_t> heap_pushes;
+        std::vector<size_t> heap_pops;
+        std::vector<size_t> wall_time_us;
+    };
 
     class TransportRouter {
     public:
-        TransportRouter(const catalogue::TransportCatalogue& catalogue, int bus_wait_time, int bus_velocity);
-        std::optional<const std::vector<RouteElem>> ComputeRoute(const std::string_view from, const std::string_view to);
+        TransportRouter(const catalogue::TransportCatalogue& catalogue, const RoutingSettings& settings);
+        // query_stats, if given, receives the counters of this query
+        std::optional<const std::vector<RouteElem>> ComputeRoute(const std::string_view from, const std::string_view to, QueryStats* query_stats = nullptr);
+        // Answers a batch of requests with one search per distinct origin; origins run in parallel.
+        // Result i is the answer to requests[i].
+        std::vector<std::optional<std::vector<RouteElem>>> ComputeRoutes(const std::vector<RouteRequest>& requests) const;
+        // Earliest arrival on the bus timetables, leaving `from` at departure_time.
+        // Wait items hold the actual wait for each trip; buses without a timetable are not used.
+        std::optional<std::vector<RouteElem>> ComputeRoute(const std::string_view from, const std::string_view to, double departure_time) const;
+        // Every stop reachable from `from` within max_time, `from` itself included, sorted by time
+        // then name; std::nullopt if there is no such stop in the catalogue
+        std::optional<std::vector<IsochroneElem>> ComputeIsochrone(const std::string_view from, double max_time) const;
+        // Shortest travel times between all sources and targets, one search per source, sources in
+        // parallel; std::nullopt if any name is not a stop of the catalogue
+        std::optional<TravelTimeMatrix> ComputeMatrix(const std::vector<std::string_view>& sources, const std::vector<std::string_view>& targets) const;
+
+        // Applies new bus_wait_time and bus_velocity without regenerating the graph: every edge
+        // weight is recomputed from the distance and kind kept in its route elem, then the router
+        // preprocessing is rebuilt on the new weights. Not safe to call during queries.
+        void Customize(int bus_wait_time, int bus_velocity);
+
+        SearchTotals GetSearchTotals() const;
+        QueryHistograms GetQueryHistograms() const;
+        cache::CacheStats GetRouteCacheStats() const;
     private:
+        struct BusEdge {
+            graph::Edge<double> edge;
+            RouteElem elem;
+        };
+
         void BuildGraph();
         void ComputeDistancesAndGenerateEdges();
+        std::vector<BusEdge> GenerateBusEdges(const Bus* bus) const;
+        void PruneDominatedEdges(std::vector<BusEdge>& edges) const;
+        void GenerateLineEdges();
+        void BuildRouter();
+        double ComputeTravelTime(int distance) const;
+        double ComputeEdgeWeight(const RouteElem& elem) const;
+        graph::AltRouter<double, graph::CsrGraph<double>>::LowerBound MakeGeoLowerBound() const;
+        void AddSearchStats(const graph::SearchStats& stats) const;
+        void RecordQuery(const QueryStats& stats) const;
+
+        uint64_t ComputeFingerprint() const;
+        bool LoadCache(uint64_t fingerprint);
+        bool SaveCache(uint64_t fingerprint) const;
+
+        using PartitionedRouter = graph::PartitionedRouter<double, graph::CsrGraph<double>>;
+
+        std::vector<uint32_t> PartitionVertices() const;
+        std::string GetCellFile(size_t cell) const;
+        bool LoadPartition(uint64_t fingerprint);
+        bool SavePartition(uint64_t fingerprint) const;
+        PartitionedRouter::Cell LoadCell(size_t cell, uint64_t fingerprint) const;
+
+        using ContractionHierarchy = graph::ContractionHierarchy<double, graph::CsrGraph<double>>;
+
+        bool LoadHierarchy(uint64_t fingerprint);
+        bool SaveHierarchy(uint64_t fingerprint) const;
+
+        // Cached edge list of a route: std::nullopt for an unreachable target
+        using CachedRoute = std::optional<std::vector<uint32_t>>;
+
+        std::optional<std::vector<graph::EdgeId>> BuildRouteEdges(graph::VertexId from, graph::VertexId to, QueryStats* query_stats = nullptr) const;
+        std::optional<std::vector<graph::EdgeId>> SearchRouteEdges(graph::VertexId from, graph::VertexId to, graph::SearchStats& stats) const;
+        std::vector<std::optional<std::vector<graph::EdgeId>>> BuildRouteEdgesFrom(graph::VertexId from, const std::vector<graph::VertexId>& targets) const;
+        std::vector<RouteElem> BuildRouteElems(const std::vector<graph::EdgeId>& edges) const;
+        std::vector<RouteElem> BuildJourneyElems(const Journey& journey) const;
+
         int bus_wait_time_;
         int bus_velocity_;
+        RouterType router_type_;
+        GraphModel graph_model_;
+        bool prune_dominated_edges_;
+        int landmark_count_;
+        int partition_cell_size_;
+        int thread_count_;
+        std::string cache_file_;
         const catalogue::TransportCatalogue& catalogue_;
 
         VertexByStop vertex_by_stop_;
@@ -48,7 +212,30 @@ namespace router {
         RouteElemByEdge route_elem_by_edge_;
 
         std::unique_ptr<graph::DirectedWeightedGraph<double>> graph_;
-        std::unique_ptr<graph::Router<double>> router_;
+        std::unique_ptr<graph::CsrGraph<double>> csr_graph_;
+        std::unique_ptr<graph::AllPairsRouter<double>> router_;
+        std::unique_ptr<graph::DijkstraRouter<double, graph::CsrGraph<double>>> dijkstra_router_;
+        std::unique_ptr<ContractionHierarchy> contraction_hierarchy_;
+        std::unique_ptr<graph::AltRouter<double, graph::CsrGraph<double>>> alt_router_;
+        std::unique_ptr<PartitionedRouter> partitioned_router_;
+        std::unique_ptr<Raptor> raptor_;
+        std::unique_ptr<ConnectionScan> connection_scan_;
+
+        // Keyed on the arrival vertices of the two stops, one per stop: from << 32 | to
+        mutable cache::ShardedLruCache<uint64_t, CachedRoute> route_cache_;
+
+        mutable std::atomic<size_t> query_count_ = 0;
+        mutable std::atomic<size_t> settled_vertices_ = 0;
+
+        struct QueryRecorder {
+            std::atomic<size_t> query_count = 0;
+            instrumentation::Histogram settled_vertices;
+            instrumentation::Histogram relaxed_edges;
+            instrumentation::Histogram heap_pushes;
+            instrumentation::Histogram heap_pops;
+            instrumentation::Histogram wall_time_us;
+        };
+        mutable QueryRecorder query_recorder_;
 
     };
 